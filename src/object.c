@@ -26,372 +26,4823 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <setjmp.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sched.h>
 
 #include "object.h"
 
 object make_int(int x) {
   object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(int_ot) | (uint32_t)x;
+#else
   o.tag = int_ot;
   o.value.int_v = x;
+#endif
   return o;
 }
 
 object make_double(double x) {
   object o;
+#ifdef GENERAL_NANBOX
+  if (x != x) {
+    o.value.bits = 0x7FF8000000000000ull; /* the one NaN */
+  } else {
+    o.value.double_v = x;
+  }
+#else
   o.tag = double_ot;
   o.value.double_v = x;
+#endif
   return o;
 }
 
 object make_byte(byte x) {
   object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(byte_ot) | (unsigned char)x;
+#else
   o.tag = byte_ot;
   o.value.byte_v = x;
+#endif
+  return o;
+}
+
+/**
+ * A string object for s, a STRING_HEAP string.
+ */
+object string_value(string s) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(string_ot) | (uintptr_t)s;
+#else
+  o.tag = string_ot;
+  o.form = STRING_HEAP;
+  o.value.string_v = s;
+#endif
   return o;
 }
 
+/**
+ * Short strings are copied inline, longer ones are referred to as
+ * they are until cons() or ocopy() copies them.
+ */
 object make_string(string x) {
+  if (intern_strings) {
+    return make_symbol(x);
+  }
   object o;
+  long int length = x ? strnlen(x, STRING_SMALL_MAX + 1) : STRING_SMALL_MAX + 1;
+  if (length > STRING_SMALL_MAX) {
+#ifdef GENERAL_NANBOX
+    o.value.bits = NANBOX_RAW_STRING | (uintptr_t)x;
+#else
+    o.tag = string_ot;
+    o.form = STRING_RAW;
+    o.value.string_v = x;
+#endif
+    return o;
+  }
+#ifdef GENERAL_NANBOX
+  o.value.bits = NANBOX_SMALL_STRING;
+#else
   o.tag = string_ot;
-  o.value.string_v = x;
+  o.form = STRING_SMALL;
+  memset(o.value.small, 0, sizeof(o.value.small));
+#endif
+  memcpy(o.value.small, x, length);
   return o;
 }
 
+object make_symbol(string x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(symbol_ot) | (uintptr_t)ointern(x);
+#else
+  o.tag = symbol_ot;
+  o.form = STRING_HEAP;
+  o.value.string_v = ointern(x);
+#endif
+  return o;
+}
 
-object* cons(object a, object* b) {
-  cell* c = malloc(sizeof(cell));
-  c->car = *ocopy(&a);
-  c->cdr = b;
-  object* o = oalloc();
-  o->tag = cell_ot;
-  o->value.cell_v = c;
+object make_cell(cell* x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(cell_ot) | (uintptr_t)x;
+#else
+  o.tag = cell_ot;
+  o.value.cell_v = x;
+#endif
   return o;
 }
 
-object* oalloc() {
-  static bool did = false;
-  if (!did) {
-    did = true;
-    printf("setting up stuff\n");
-    allocated_objects = malloc(sizeof(object*) * 50);
-    allocated_objects_length = 50;
-  }
+/**
+ * A header for a cdr coded cell, its cdr is the next header in the
+ * run.
+ */
+object make_coded_cell(cell* x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(cell_ot) | (uintptr_t)x | 1;
+#else
+  o.tag = cell_ot;
+  o.value.cell_v = (cell*)((uintptr_t)x | 1);
+#endif
+  return o;
+}
 
-  object* x = malloc(sizeof(object));
+object make_vector(vector* x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(vector_ot) | (uintptr_t)x;
+#else
+  o.tag = vector_ot;
+  o.value.vector_v = x;
+#endif
+  return o;
+}
 
-  if (objects_allocated >= allocated_objects_length) {
-    long int new_size = round(allocated_objects_length * 1.5);
-    object** new_list = malloc(sizeof(object*) * new_size);
-    memcpy(new_list, allocated_objects, allocated_objects_length);
-    allocated_objects_length = new_size;
-    object** old = allocated_objects;
-    free(old);
-    allocated_objects = new_list;
-  }
+object make_ints(array* x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(ints_ot) | (uintptr_t)x;
+#else
+  o.tag = ints_ot;
+  o.value.array_v = x;
+#endif
+  return o;
+}
 
-  allocated_objects[objects_allocated] = x;
-  objects_allocated ++;
+object make_doubles(array* x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(doubles_ot) | (uintptr_t)x;
+#else
+  o.tag = doubles_ot;
+  o.value.array_v = x;
+#endif
+  return o;
+}
 
-  x->tag = int_ot;
-  x->value.int_v = 0;
-  return x;
+object make_hashmap(hashmap* x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(hashmap_ot) | (uintptr_t)x;
+#else
+  o.tag = hashmap_ot;
+  o.value.hashmap_v = x;
+#endif
+  return o;
 }
 
-int ofree(object* o) {
-  if (!o) {
-    return 0;
-  } else {
-    int c = 0;
-    object* next = NULL;
-    do {
-      next = NULL;
-      if (is(*o, cell)) {
-        next = cdr(o);
-      }
-      if ((is(*o, string) || is(*o, error)) && stringv(o)) {
-        free(stringv(o));
-      }
-      if (o != NIL && o != T) {
-        free(o);
-        c += 1;
-      }
-      o = next;
-    } while (o);
+object make_unrolled(unrolled* x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(unrolled_ot) | (uintptr_t)x;
+#else
+  o.tag = unrolled_ot;
+  o.value.unrolled_v = x;
+#endif
+  return o;
+}
 
-    return c;
+object make_headed(struct general_builder* x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(headed_ot) | (uintptr_t)x;
+#else
+  o.tag = headed_ot;
+  o.value.headed_v = x;
+#endif
+  return o;
+}
+
+object make_deque(deque* x) {
+  object o;
+#ifdef GENERAL_NANBOX
+  o.value.bits = nanbox_box(deque_ot) | (uintptr_t)x;
+#else
+  o.tag = deque_ot;
+  o.value.deque_v = x;
+#endif
+  return o;
+}
+
+
+/* **************************************************************
+ * Pointer sets
+ * ************************************************************** */
+
+long int ptrset_slot(struct general_ptrset* set, void* p) {
+  uint64_t h = ((uintptr_t)p >> 4) * 0x9E3779B97F4A7C15ull;
+  long int i = (long int)(h >> 32) & (set->size - 1);
+  while (set->keys[i] && set->keys[i] != p) {
+    i = (i + 1) & (set->size - 1);
   }
+  return i;
 }
 
-object oadd(object* args) {
-  int iout = 0;
-  double dout = 0;
-  bool is_int = true;
-  for (object* o = args; ! is((*o), nil); o = cellv(o)->cdr) {
-    cell* c = cellv(o);
-    if (is(c->car, int)) {
-      iout += c->car.value.int_v;
-      dout += c->car.value.int_v;
-    } else if (is(c->car, double)) {
-      is_int = false;
-      dout += c->car.value.double_v;
-    } else {
-      ppo((*o));
-      //error
+long int ptrset_find(struct general_ptrset* set, void* p) {
+  if (!set->count || !p) {
+    return -1;
+  }
+  long int i = ptrset_slot(set, p);
+  return set->keys[i] ? i : -1;
+}
+
+void ptrset_add(struct general_ptrset* set, void* p) {
+  if ((set->count + 1) * 2 > set->size) {
+    struct general_ptrset old = *set;
+    set->size = old.size ? old.size * 2 : 64;
+    set->keys = calloc(set->size, sizeof(void*));
+    set->marks = calloc(set->size, 1);
+    set->count = 0;
+    for (long int i = 0; i < old.size; i++) {
+      if (old.keys[i]) {
+        long int j = ptrset_slot(set, old.keys[i]);
+        set->keys[j] = old.keys[i];
+        set->marks[j] = old.marks[i];
+        set->count++;
+      }
     }
+    free(old.keys);
+    free(old.marks);
+  }
+  long int i = ptrset_slot(set, p);
+  if (!set->keys[i]) {
+    set->keys[i] = p;
+    set->marks[i] = 0;
+    set->count++;
+  }
+}
+
+void ptrset_remove(struct general_ptrset* set, void* p) {
+  long int i = ptrset_find(set, p);
+  if (i < 0) {
+    return;
+  }
+  set->keys[i] = NULL;
+  set->count--;
+  /* shift the rest of the probe run back over the hole */
+  for (long int j = (i + 1) & (set->size - 1);
+       set->keys[j];
+       j = (j + 1) & (set->size - 1)) {
+    void* k = set->keys[j];
+    unsigned char m = set->marks[j];
+    set->keys[j] = NULL;
+    long int to = ptrset_slot(set, k);
+    set->keys[to] = k;
+    set->marks[to] = m;
+  }
+}
+
+long int ptrmap_slot(struct general_ptrmap* map, void* p) {
+  uint64_t h = ((uintptr_t)p >> 4) * 0x9E3779B97F4A7C15ull;
+  long int i = (long int)(h >> 32) & (map->size - 1);
+  while (map->keys[i] && map->keys[i] != p) {
+    i = (i + 1) & (map->size - 1);
   }
-  return is_int ? make_int(iout) : make_double (dout);
+  return i;
 }
 
 /**
- * Subtract args, if only one, negate.
+ * p's number, -1 if it has none.
  */
-object ominus(object* args) {
-  int iout = 0;
-  double dout = 0;
-  bool is_int = true;
-  cell list = *args->value.cell_v;
-  if (is(list.car, int)) {
-    iout = list.car.value.int_v;
-    dout = list.car.value.int_v;
-  } else if (is(list.car, double)) {
-    is_int = false;
-    dout = list.car.value.double_v;
-  }
-
-  if ((!list.cdr) || is((list.cdr->value.cell_v->car), nil)) {
-    iout = -iout;
-    dout = -dout;
-  } else {
-    for (object* o = args; ! is((*o), nil); o = cellv(o)->cdr) {
-      cell* c = cellv(o);
-      if (is(c->car, int)) {
-        iout -= c->car.value.int_v;
-        dout -= c->car.value.int_v;
-      } else if (is(c->car, double)) {
-        is_int = false;
-        dout -= c->car.value.double_v;
-      } else {
-        //error
+long int ptrmap_find(struct general_ptrmap* map, void* p) {
+  if (!map->count) {
+    return -1;
+  }
+  long int i = ptrmap_slot(map, p);
+  return map->keys[i] ? map->values[i] : -1;
+}
+
+void ptrmap_add(struct general_ptrmap* map, void* p, long int value) {
+  if ((map->count + 1) * 2 > map->size) {
+    struct general_ptrmap old = *map;
+    map->size = old.size ? old.size * 2 : 64;
+    map->keys = calloc(map->size, sizeof(void*));
+    map->values = malloc(sizeof(long int) * map->size);
+    for (long int i = 0; i < old.size; i++) {
+      if (old.keys[i]) {
+        long int j = ptrmap_slot(map, old.keys[i]);
+        map->keys[j] = old.keys[i];
+        map->values[j] = old.values[i];
       }
     }
+    free(old.keys);
+    free(old.values);
   }
-  return is_int ? make_int(iout) : make_double (dout);
+  long int i = ptrmap_slot(map, p);
+  if (!map->keys[i]) {
+    map->count++;
+  }
+  map->keys[i] = p;
+  map->values[i] = value;
 }
 
-object olength(object* list) {
-  object* o = list;
-  int length = 0;
-  if (is(*o, nil)) {
-    return make_int(length);
+void ptrmap_remove(struct general_ptrmap* map, void* p) {
+  if (!map->count) {
+    return;
+  }
+  long int i = ptrmap_slot(map, p);
+  if (!map->keys[i]) {
+    return;
+  }
+  map->keys[i] = NULL;
+  map->count--;
+  /* shift the rest of the probe run back over the hole */
+  for (long int j = (i + 1) & (map->size - 1);
+       map->keys[j];
+       j = (j + 1) & (map->size - 1)) {
+    void* k = map->keys[j];
+    long int v = map->values[j];
+    map->keys[j] = NULL;
+    long int to = ptrmap_slot(map, k);
+    map->keys[to] = k;
+    map->values[to] = v;
   }
+}
 
-  while(is(*o, cell)) {
-    length++;
-    o = cdr(o);
+void ptrmap_free(struct general_ptrmap* map) {
+  free(map->keys);
+  free(map->values);
+  *map = (struct general_ptrmap){ 0 };
+}
+
+/* **************************************************************
+ * Interning
+ * ************************************************************** */
+
+/**
+ * FNV-1a of length bytes, folded to 32 bits so heap strings can cache
+ * it.
+ */
+uint64_t string_hash(string s, long int length) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (long int i = 0; i < length; i++) {
+    h = (h ^ (unsigned char)s[i]) * 0x100000001b3ull;
   }
+  return (uint32_t)(h ^ (h >> 32));
+}
 
-  if (is(*o, nil)) {
-    return make_int(length);
-  } else {
-    //error (1 2 . 3) scenario
-    return make_int(-1);
+/**
+ * Where s is, or would go, in the table.
+ */
+long int intern_slot(struct general_intern_table* table, string s, uint64_t h) {
+  long int i = (long int)(h >> 32) & (table->size - 1);
+  while (table->keys[i] &&
+         (table->hashes[i] != h || strcmp(table->keys[i], s) != 0)) {
+    i = (i + 1) & (table->size - 1);
   }
+  return i;
 }
 
-object* olast(object* list) {
-  object* last = list;
-  ofor_each(elm, head, list) {
-    last = head;
+/**
+ * Bump allocate size bytes, 8 byte aligned, from a list of chunks.
+ */
+void* chunk_alloc(struct general_chunk** chunks, long int size) {
+  size = (size + 7) & ~7L;
+  if (!*chunks || (*chunks)->used + size > (*chunks)->size) {
+    long int chunk_size = size > REGION_CHUNK_SIZE ? size : REGION_CHUNK_SIZE;
+    struct general_chunk* chunk = malloc(sizeof(struct general_chunk) + chunk_size);
+    chunk->next = *chunks;
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    *chunks = chunk;
   }
-  return last;
+  void* bytes = (*chunks)->bytes + (*chunks)->used;
+  (*chunks)->used += size;
+  return bytes;
 }
 
-object* oappend(object* args) {
-  object* copied = ocopy(args);
-  ofor_each(list, head, copied) {
-    if (!is(*cdr(head), nil)) {
-      object* last = olast(list);
-      cdr(last) = &car(cdr(head));
+/**
+ * Copy s into the table's chunks as a heap string, interned strings
+ * are never freed.
+ */
+string intern_copy(struct general_intern_table* table, string s, uint64_t h) {
+  long int length = strlen(s);
+  struct general_string* copy =
+    chunk_alloc(&table->chunks, sizeof(struct general_string) + length + 1);
+  copy->length = length;
+  copy->hash = h ? h : 1;
+  memcpy(copy->bytes, s, length + 1);
+  return copy->bytes;
+}
+
+string ointern(string s) {
+  struct general_intern_table* table = &intern_table;
+  uint64_t h = string_hash(s, strlen(s));
+  pthread_mutex_lock(&heap_lock);
+  if ((table->count + 1) * 2 > table->size) {
+    struct general_intern_table old = *table;
+    table->size = old.size ? old.size * 2 : 256;
+    table->keys = calloc(table->size, sizeof(string));
+    table->hashes = calloc(table->size, sizeof(uint64_t));
+    for (long int i = 0; i < old.size; i++) {
+      if (old.keys[i]) {
+        long int j = intern_slot(table, old.keys[i], old.hashes[i]);
+        table->keys[j] = old.keys[i];
+        table->hashes[j] = old.hashes[i];
+      }
     }
+    free(old.keys);
+    free(old.hashes);
+  }
+
+  long int i = intern_slot(table, s, h);
+  if (!table->keys[i]) {
+    table->keys[i] = intern_copy(table, s, h);
+    table->hashes[i] = h;
+    table->count++;
   }
-  return &car(copied);
+  string interned = table->keys[i];
+  pthread_mutex_unlock(&heap_lock);
+  return interned;
 }
 
-object* opop(object* list) {
-  object* value = ocopy(&car(list));
+/* **************************************************************
+ * Garbage collection
+ * ************************************************************** */
 
-  if (olength(list).value.int_v > 1) {
-    car(list) = car(cdr(list));
-    cdr(list) = cdr(cdr(list));
-  } else {
-    *list = *NIL;
+void ogc_root(object* o) {
+  pthread_mutex_lock(&heap_lock);
+  if (gc_roots_count >= gc_roots_length) {
+    gc_roots_length = gc_roots_length ? gc_roots_length * 2 : 16;
+    gc_roots = realloc(gc_roots, sizeof(object*) * gc_roots_length);
   }
-  return value;
+  gc_roots[gc_roots_count++] = o;
+  pthread_mutex_unlock(&heap_lock);
 }
 
-object* opush(object elm, object* list) {
-  cdr(list) = cons(car(list), cdr(list));
-  car(list) = elm;
-  pl(list);
-  return list;
+void ogc_unroot(object* o) {
+  pthread_mutex_lock(&heap_lock);
+  for (long int i = gc_roots_count - 1; i >= 0; i--) {
+    if (gc_roots[i] == o) {
+      gc_roots[i] = gc_roots[--gc_roots_count];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&heap_lock);
 }
 
-object* onumber_equal(object* a, object* b) {
-  if (is(*a, int) && is(*b, int)) {
-    return booly(intv(a) == intv(b));
+#define SLAB_MAP_WORD (8 * sizeof(unsigned long int))
+
+/**
+ * The word of slab_page_map with page's bit, NULL if page is above the
+ * map or make is false and its leaf hasn't been made.
+ */
+unsigned long int* slab_map_word(struct general_page* page, bool make) {
+  uintptr_t n = (uintptr_t)page / SLAB_PAGE_SIZE;
+  if (n >> (2 * SLAB_MAP_BITS)) {
+    return NULL;
+  }
+  unsigned long int** top = &slab_page_map[n >> SLAB_MAP_BITS];
+  unsigned long int* leaf = __atomic_load_n(top, __ATOMIC_ACQUIRE);
+  if (!leaf && make) {
+    leaf = calloc((1 << SLAB_MAP_BITS) / SLAB_MAP_WORD, sizeof(unsigned long int));
+    __atomic_store_n(top, leaf, __ATOMIC_RELEASE);
+  }
+  return leaf ? &leaf[(n & ((1 << SLAB_MAP_BITS) - 1)) / SLAB_MAP_WORD] : NULL;
+}
+
+/**
+ * Add a new slab page to the map, or take away one being freed.
+ */
+void slab_map_set(struct general_page* page, bool present) {
+  pthread_mutex_lock(&heap_lock);
+  unsigned long int* word = slab_map_word(page, true);
+  unsigned long int bit = 1ul << ((uintptr_t)page / SLAB_PAGE_SIZE % SLAB_MAP_WORD);
+  if (!word) {
+    if (present) {
+      ptrset_add(&slab_page_set, page);
+    } else {
+      ptrset_remove(&slab_page_set, page);
+    }
+  } else if (present) {
+    __atomic_or_fetch(word, bit, __ATOMIC_RELEASE);
   } else {
-    double ad = numberv(*a);
-    double bd = numberv(*b);
-    return booly(ad == bd);
+    __atomic_and_fetch(word, ~bit, __ATOMIC_RELEASE);
   }
-  return NIL;
+  pthread_mutex_unlock(&heap_lock);
 }
 
-object* ostring_equal(object* a, object* b) {
-  return booly(strcmp(stringv(a), stringv(b)) == 0);
+/**
+ * The slab page p points into, NULL if it isn't in one.
+ */
+struct general_page* slab_page_of(void* p) {
+  struct general_page* page = opage(p);
+  unsigned long int* word = slab_map_word(page, false);
+  bool found;
+  if (word) {
+    unsigned long int bit = 1ul << ((uintptr_t)page / SLAB_PAGE_SIZE % SLAB_MAP_WORD);
+    found = __atomic_load_n(word, __ATOMIC_ACQUIRE) & bit;
+  } else if ((uintptr_t)page / SLAB_PAGE_SIZE >> (2 * SLAB_MAP_BITS)) {
+    pthread_mutex_lock(&heap_lock);
+    found = ptrset_find(&slab_page_set, page) >= 0;
+    pthread_mutex_unlock(&heap_lock);
+  } else {
+    found = false;
+  }
+  if (!found) {
+    return NULL;
+  }
+  char* start = (char*)page->slots;
+  if ((char*)p < start || (char*)p >= start + page->used * sizeof(struct general_slot)) {
+    return NULL;
+  }
+  return page;
 }
 
-object* ocopy(object* o) {
-  if (is(*o, t)) {
-    return T;
-  } else if (is(*o, nil)) {
-    return NIL;
+/**
+ * Objects reached but not yet traced.
+ */
+object** gc_stack = NULL;
+long int gc_stack_count = 0;
+long int gc_stack_length = 0;
+
+void gc_push(object* o) {
+  if (gc_stack_count >= gc_stack_length) {
+    gc_stack_length = gc_stack_length ? gc_stack_length * 2 : 256;
+    gc_stack = realloc(gc_stack, sizeof(object*) * gc_stack_length);
   }
+  gc_stack[gc_stack_count++] = o;
+}
 
-  object* copy = oalloc();
-  *copy = *o;
-  if (is(*copy, string)) {
-    string newString = malloc(sizeof(stringv(o)));
-    stringv(copy) = newString;
-    strcpy(stringv(copy), stringv(o));
-  } else if (is(*copy, cell)) {
-    cell* newCell = malloc(sizeof(cell));
-    cellv(copy) = newCell;
-    newCell->car = cellv(o)->car;
-    newCell->cdr = ocopy(cellv(o)->cdr);
+/**
+ * gc_push() for ogc_barrier(), on any thread: the cycle may have moved
+ * on since the phase was checked.
+ */
+void gc_barrier_push(object* o) {
+  pthread_mutex_lock(&gc_lock);
+  if (gc_phase == GC_MARK) {
+    gc_push(o);
   }
-  return copy;
+  pthread_mutex_unlock(&gc_lock);
 }
 
-object* oequal(object* a, object* b) {
-  if (is_number(a) && is_number(b)) {
+/**
+ * Cycle bookkeeping. Owned strings are live when their mark is
+ * gc_epoch, which moves on every cycle so marks never need clearing.
+ * Heaps are swept one after the other from gc_sweep_heap, each up
+ * from its sweep mark.
+ */
+unsigned char gc_epoch = 0;
+struct general_heap* gc_sweep_heap = NULL;
+long int gc_string_cursor = 0;
+long int gc_run_cursor = 0;
+long int gc_freed = 0;
+bool gc_stale = false; /* an abandoned cycle left marks in the registries */
 
-    return onumber_equal(a, b);
+void gc_mark_string(string s) {
+  for (struct general_heap* h = heaps; h; h = h->next) {
+    long int i = ptrset_find(&h->strings, s);
+    if (i >= 0) {
+      h->strings.marks[i] = gc_epoch;
+      return;
+    }
+  }
+}
 
-  } else {
+/**
+ * Queue what a car or item refers to. Strings are marked right away.
+ */
+void gc_shade_value(object* o) {
+  if ((is(*o, string) || is(*o, error)) && ostring_form(o) != STRING_SMALL) {
+    gc_mark_string(stringv(o));
+  } else if (is(*o, cell) || is(*o, vector) || is(*o, ints) || is(*o, doubles) ||
+             is(*o, hashmap) || is(*o, unrolled) || is(*o, headed) || is(*o, deque)) {
+    gc_push(o);
+  }
+}
 
-    if (a->tag != b->tag) {
-      return NIL;
+/**
+ * Set the cell mark of the slot p is in, false if it was already set
+ * or the slot is free. Cells and vectors outside the slab are always
+ * traced.
+ */
+bool gc_mark_body(void* p) {
+  struct general_page* page = slab_page_of(p);
+  if (page) {
+    long int i = oslot_index(p);
+    if (!(page->flags[i] & SLOT_LIVE) || (page->flags[i] & SLOT_MARK_CELL)) {
+      return false;
     }
+    page->flags[i] |= SLOT_MARK_CELL;
+  }
+  return true;
+}
 
-    switch (a->tag) {
-    case string_ot:
-      return ostring_equal(a, b);
-    case byte_ot:
-      return booly(bytev(a) == bytev(b));
-    case error_ot:
-      return ostring_equal(a, b);
-      return NIL;
-    case nil_ot:
-      return T;
-    case t_ot:
-      return T;
-    case cell_ot: {
-      if (is(*oequal(&car(a), &car(b)), t)) {
-        return oequal(cdr(a), cdr(b));
-      } else {
-        return NIL;
-      }
-    }
-    default:
-      return NIL;
+void gc_shade_cell(cell*);
+
+/**
+ * Mark a compact run and shade all of its cells at once. A coded cell
+ * that was given its own cdr is shaded through the cell it moved to.
+ */
+void gc_shade_run(struct general_run* run) {
+  long int i = ptrset_find(&compact_runs, run);
+  if (i < 0 || compact_runs.marks[i] == gc_epoch) {
+    return;
+  }
+  compact_runs.marks[i] = gc_epoch;
+  for (int j = 0; j < run->length; j++) {
+    struct general_packed* p = &run->cells[j];
+    gc_shade_value(&p->car);
+    if (is(p->obj, cell) && cellv(&p->obj) != (cell*)&p->car) {
+      gc_shade_cell(cellv(&p->obj));
     }
   }
+  struct general_packed* last = &run->cells[run->length - 1];
+  if (is(last->obj, cell)) {
+    gc_push(cellv(&last->obj)->cdr);
+  }
 }
 
+/**
+ * Mark a cell and queue its car and cdr.
+ */
+void gc_shade_cell(cell* c) {
+  struct general_run* run =
+    compact_runs.count && !slab_page_of(c) ? compact_run_find(c) : NULL;
+  if (run) {
+    gc_shade_run(run);
+  } else if (gc_mark_body(c)) {
+    gc_shade_value(&c->car);
+    gc_push(c->cdr);
+  }
+}
 
 /**
- * Pretty Print Object.
+ * Mark a vector and its items array, and queue its items.
  */
-void ppo(object o) {
-  printf("object <%s>\n  value: ", tag_string(o.tag));
-  switch(o.tag)
-    {
-    case int_ot:
-      printf("%d", o.value.int_v);
-      break;
-    case double_ot:
-      printf("%f", o.value.double_v);
-      break;
-    case string_ot:
-      printf("%s", o.value.string_v);
-      break;
-    case byte_ot:
-      printf("%#1x", o.value.byte_v);
-      break;
-    case error_ot:
-      printf("%s", o.value.string_v);
-      break;
-    case nil_ot:
-      printf("nil");
-      break;
-    case t_ot:
-      printf("nil");
-      break;
-    case cell_ot:
-      printf("car: \n");
-      ppo(cellv((&o))->car);
-      break;
-    default:
-      printf("???");
+void gc_shade_vector(vector* v) {
+  if (gc_mark_body(v)) {
+    gc_mark_string((string)v->items);
+    for (int i = 0; i < v->length; i++) {
+      gc_shade_value(&v->items[i]);
+    }
+  }
+}
+
+/**
+ * Mark an ints or doubles array and its elements.
+ */
+void gc_shade_array(array* a) {
+  if (gc_mark_body(a)) {
+    gc_mark_string(a->data);
+  }
+}
+
+void gc_shade_table(struct general_table* table) {
+  gc_mark_string((string)table);
+  for (int i = 0; i < table->capacity; i++) {
+    if (table->entries[i].hash > HASHMAP_DELETED) {
+      gc_shade_value(&table->entries[i].key);
+      gc_shade_value(&table->entries[i].value);
+    }
+  }
+}
+
+/**
+ * Mark a hashmap and its tables, and queue its keys and values.
+ */
+void gc_shade_hashmap(hashmap* m) {
+  if (gc_mark_body(m)) {
+    gc_shade_table(m->table);
+    if (m->old) {
+      gc_shade_table(m->old);
+    }
+  }
+}
+
+/**
+ * Mark an unrolled list and its blocks, and queue its items.
+ */
+void gc_shade_unrolled(unrolled* u) {
+  if (gc_mark_body(u) && u->first) {
+    struct general_block* b = u->first;
+    do {
+      gc_mark_string((string)b);
+      for (int i = b->start; i < b->start + b->count; i++) {
+        gc_shade_value(&b->items[i]);
+      }
+      b = b->next;
+    } while (b != u->first);
+  }
+}
+
+/**
+ * Mark a deque and its ring, and queue its items.
+ */
+void gc_shade_deque(deque* d) {
+  if (gc_mark_body(d)) {
+    gc_mark_string((string)d->ring);
+    for (int i = 0; i < d->ring->length; i++) {
+      gc_shade_value(deque_item(d->ring, i));
+    }
+  }
+}
+
+/**
+ * Mark o and what its value refers to. o may be a header, a car or
+ * an object outside the slab.
+ */
+void gc_trace(object* o) {
+  if (!o) {
+    return;
+  }
+  struct general_page* page = slab_page_of(o);
+  if (page) {
+    long int i = oslot_index(o);
+    if (!(page->flags[i] & SLOT_LIVE)) {
+      return;
+    }
+    if (o == &page->slots[i].obj) {
+      if (page->flags[i] & SLOT_MARK_OBJ) {
+        return;
+      }
+      page->flags[i] |= SLOT_MARK_OBJ;
+    }
+  } else if (compact_runs.count) {
+    struct general_run* run = compact_run_find(o);
+    if (run && ((char*)o - (char*)run->cells) % sizeof(struct general_packed) == 0) {
+      /* a header in a run, cars in one are traced as usual */
+      gc_shade_run(run);
+      return;
+    }
+  }
+
+  if ((is(*o, string) || is(*o, error)) && ostring_form(o) != STRING_SMALL) {
+    gc_mark_string(stringv(o));
+  } else if (is(*o, cell)) {
+    gc_shade_cell(cellv(o));
+  } else if (is(*o, vector)) {
+    gc_shade_vector(vectorv(o));
+  } else if (is(*o, ints) || is(*o, doubles)) {
+    gc_shade_array(arrayv(o));
+  } else if (is(*o, hashmap)) {
+    gc_shade_hashmap(hashmapv(o));
+  } else if (is(*o, unrolled)) {
+    gc_shade_unrolled(unrolledv(o));
+  } else if (is(*o, headed)) {
+    gc_mark_string((string)headedv(o));
+    gc_push(oheaded_list(o));
+  } else if (is(*o, deque)) {
+    gc_shade_deque(dequev(o));
+  }
+}
+
+/**
+ * Queue anything on the stack that points into a slot or is a string
+ * we own.
+ */
+void __attribute__((noinline, no_sanitize_address)) gc_mark_stack() {
+  jmp_buf registers;
+  setjmp(registers);
+  void** top = (void**)&registers;
+  for (void** p = top; (void*)p < gc_stack_base; p++) {
+    void* word = *p;
+    struct general_page* page = slab_page_of(word);
+    if (page && (page->flags[oslot_index(word)] & SLOT_LIVE)) {
+      struct general_slot* slot = &page->slots[oslot_index(word)];
+      gc_push(&slot->obj);
+      if (page->flags[oslot_index(word)] & SLOT_VECTOR) {
+        gc_shade_vector((vector*)&slot->cell);
+      } else if (page->flags[oslot_index(word)] & SLOT_ARRAY) {
+        gc_shade_array((array*)&slot->cell);
+      } else if (page->flags[oslot_index(word)] & SLOT_HASHMAP) {
+        gc_shade_hashmap((hashmap*)&slot->cell);
+      } else if (page->flags[oslot_index(word)] & SLOT_UNROLLED) {
+        gc_shade_unrolled((unrolled*)&slot->cell);
+      } else if (page->flags[oslot_index(word)] & SLOT_DEQUE) {
+        gc_shade_deque((deque*)&slot->cell);
+      } else {
+        gc_shade_cell(&slot->cell);
+      }
+    } else if (compact_runs.count && compact_run_find(word)) {
+      gc_shade_run(compact_run_find(word));
+    } else {
+      gc_mark_string(word);
+#ifdef GENERAL_NANBOX
+      /* a boxed string value held in a local */
+      gc_mark_string((void*)(uintptr_t)((uintptr_t)word & NANBOX_PAYLOAD));
+#endif
+    }
+  }
+}
+
+void gc_mark_roots() {
+  for (long int i = 0; i < gc_roots_count; i++) {
+    gc_push(gc_roots[i]);
+  }
+  /* and so is every counted object */
+  if (__atomic_load_n(&refs_counted, __ATOMIC_RELAXED)) {
+    for (struct general_heap* h = heaps; h; h = h->next) {
+      for (long int i = 0; i < h->count; i++) {
+        if (orefs_word(h->objects[i])) {
+          gc_push(h->objects[i]);
+        }
+      }
+    }
+  }
+  /* cells unlinked since the cycle started are freed by their epoch */
+  for (struct general_heap* h = heaps; h; h = h->next) {
+    for (int i = 0; i < 3; i++) {
+      for (long int j = 0; j < h->limbo[i].count; j++) {
+        gc_push(h->limbo[i].cells[j]);
+      }
+    }
+  }
+  if (gc_scan_stack && gc_stack_base) {
+    gc_mark_stack();
+  }
+}
+
+/**
+ * Drop queued objects that live in [start, end), a page or chunk
+ * about to be freed.
+ */
+void gc_forget(void* start, void* end) {
+  long int kept = 0;
+  for (long int i = 0; i < gc_stack_count; i++) {
+    if ((void*)gc_stack[i] < start || (void*)gc_stack[i] >= end) {
+      gc_stack[kept++] = gc_stack[i];
+    }
+  }
+  gc_stack_count = kept;
+}
+
+long int heap_reclaim(struct general_heap*);
+void limbo_free(struct general_limbo*);
+
+/**
+ * Clear the marks of this thread's region slots, which the registries
+ * don't list.
+ */
+void gc_clear_regions() {
+  for (struct general_region* r = current_region; r; r = r->parent) {
+    for (struct general_page* page = r->pages; page; page = page->next) {
+      for (unsigned long int j = 0; j < page->used; j++) {
+        page->flags[j] &= ~SLOT_MARKS;
+      }
+    }
+  }
+}
+
+void gc_start() {
+  if (gc_stale) {
+    for (struct general_heap* h = heaps; h; h = h->next) {
+      for (long int i = 0; i < h->count; i++) {
+        opage(h->objects[i])->flags[oslot_index(h->objects[i])] &= ~SLOT_MARKS;
+      }
+    }
+    gc_stack_count = 0;
+    gc_stale = false;
+  }
+  /* the last cycle, abandoned or not, may have been on another thread */
+  gc_clear_regions();
+  /* no thread is in opop_atomic() while a cycle starts */
+  for (struct general_heap* h = heaps; h; h = h->next) {
+    for (int i = 0; i < 3; i++) {
+      limbo_free(&h->limbo[i]);
+    }
+  }
+  for (struct general_heap* h = heaps; h; h = h->next) {
+    heap_reclaim(h);
+  }
+  gc_epoch = gc_epoch == 255 ? 1 : gc_epoch + 1;
+  gc_allocated = 0;
+  gc_freed = 0;
+  __atomic_store_n(&gc_phase, GC_MARK, __ATOMIC_RELAXED);
+  gc_mark_roots();
+}
+
+/**
+ * Trace up to work objects. When the queue runs dry, rescan the roots
+ * and the stack, which the barrier doesn't cover, finish marking from
+ * them and move on to sweeping.
+ */
+long int gc_mark_some(long int work) {
+  long int done = 0;
+  while (gc_stack_count && done < work) {
+    gc_trace(gc_stack[--gc_stack_count]);
+    done++;
+  }
+  if (!gc_stack_count) {
+    gc_mark_roots();
+    while (gc_stack_count) {
+      gc_trace(gc_stack[--gc_stack_count]);
+      done++;
+    }
+    __atomic_store_n(&gc_phase, GC_SWEEP, __ATOMIC_RELAXED);
+    for (struct general_heap* h = heaps; h; h = h->next) {
+      h->sweep = h->count;
+    }
+    gc_sweep_heap = heaps;
+    gc_string_cursor = 0;
+    gc_run_cursor = 0;
+  }
+  return done;
+}
+
+void gc_finish() {
+  gc_clear_regions();
+  __atomic_store_n(&gc_phase, GC_IDLE, __ATOMIC_RELAXED);
+  gc_stats.cycles++;
+}
+
+/**
+ * Drop the cycle in flight, with gc_lock held. Its marks are cleared
+ * when the next one starts.
+ */
+void gc_abandon() {
+  __atomic_store_n(&gc_phase, GC_IDLE, __ATOMIC_RELAXED);
+  gc_stack_count = 0;
+  gc_sweep_heap = NULL;
+  gc_stale = true;
+}
+
+void heap_free(struct general_heap*, struct general_slot*);
+
+/**
+ * Sweep up to work slots, then owned strings, a heap at a time, then
+ * compacted runs. Objects allocated while sweeping land above their
+ * heap's sweep mark and are left for the next cycle.
+ */
+long int gc_sweep_some(long int work) {
+  long int done = 0;
+  while (gc_sweep_heap && done < work) {
+    struct general_heap* h = gc_sweep_heap;
+    if (h->sweep > 0) {
+      object* o = h->objects[h->sweep - 1];
+      struct general_page* page = opage(o);
+      long int j = oslot_index(o);
+      if (page->flags[j] & SLOT_MARKS) {
+        page->flags[j] &= ~SLOT_MARKS;
+        h->sweep--;
+      } else {
+        heap_free(h, oslot(o));
+        gc_freed++;
+      }
+    } else if (gc_string_cursor < h->strings.size) {
+      void* key = h->strings.keys[gc_string_cursor];
+      if (key && h->strings.marks[gc_string_cursor] != gc_epoch) {
+        /* removing shifts the next entry into this one */
+        ptrset_remove(&h->strings, key);
+        free(ostring_header(key));
+      } else {
+        gc_string_cursor++;
+      }
+    } else {
+      gc_sweep_heap = h->next;
+      gc_string_cursor = 0;
+      continue;
+    }
+    done++;
+  }
+
+  while (!gc_sweep_heap && gc_run_cursor < compact_runs.size && done < work) {
+    void* key = compact_runs.keys[gc_run_cursor];
+    if (key && compact_runs.marks[gc_run_cursor] != gc_epoch) {
+      ptrset_remove(&compact_runs, key);
+      free(key);
+    } else {
+      gc_run_cursor++;
+    }
+    done++;
+  }
+
+  if (!gc_sweep_heap && gc_run_cursor >= compact_runs.size) {
+    gc_finish();
+  }
+  return done;
+}
+
+long long int gc_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Run the current cycle for up to work units or until end_ns.
+ */
+void gc_run(long int work, long long int end_ns) {
+  while (gc_phase != GC_IDLE && work > 0) {
+    long int chunk = work < 64 ? work : 64;
+    if (gc_phase == GC_MARK) {
+      work -= gc_mark_some(chunk);
+    } else {
+      work -= gc_sweep_some(chunk);
+    }
+    if (end_ns && gc_now_ns() >= end_ns) {
+      break;
+    }
+  }
+}
+
+void gc_record_pause(long long int ns) {
+  int bucket = 0;
+  while (bucket < 63 && (2LL << bucket) <= ns) {
+    bucket++;
+  }
+  gc_stats.pauses++;
+  gc_stats.total_ns += ns;
+  if (ns > gc_stats.max_ns) {
+    gc_stats.max_ns = ns;
+  }
+  gc_stats.histogram[bucket]++;
+}
+
+long long int ogc_pause_percentile(double p) {
+  long int seen = 0;
+  for (int i = 0; i < 64; i++) {
+    seen += gc_stats.histogram[i];
+    if (seen > 0 && seen >= p * gc_stats.pauses) {
+      return 2LL << i;
+    }
+  }
+  return 0;
+}
+
+long int gc_step() {
+  long long int start = gc_now_ns();
+  long int freed = gc_freed;
+  if (gc_phase == GC_IDLE) {
+    gc_start();
+    freed = 0;
+  }
+  gc_run(gc_step_work, gc_step_ns ? start + gc_step_ns : 0);
+  gc_record_pause(gc_now_ns() - start);
+  return gc_freed - freed;
+}
+
+long int gc_collect() {
+  long long int start = gc_now_ns();
+  long int freed = gc_freed;
+  if (gc_phase == GC_IDLE) {
+    gc_start();
+    freed = 0;
+  }
+  while (gc_phase != GC_IDLE) {
+    gc_run(LONG_MAX, 0);
+  }
+  gc_record_pause(gc_now_ns() - start);
+  return gc_freed - freed;
+}
+
+long int ogc_step() {
+  pthread_mutex_lock(&gc_lock);
+  long int freed = gc_step();
+  pthread_mutex_unlock(&gc_lock);
+  return freed;
+}
+
+long int ogc_collect() {
+  pthread_mutex_lock(&gc_lock);
+  long int freed = gc_collect();
+  pthread_mutex_unlock(&gc_lock);
+  return freed;
+}
+
+bool share_spine(object*);
+void share_evacuate(object*);
+void share_unjoin(cell*);
+object shared_car(object*);
+void cell_unshare(object*, bool, bool);
+
+/**
+ * True if another list shares o's cell.
+ */
+bool cell_shared(object* o) {
+  if (!__atomic_load_n(&shared_cells.count, __ATOMIC_RELAXED)) {
+    return false;
+  }
+  pthread_mutex_lock(&heap_lock);
+  bool shared = ptrset_find(&shared_cells, cellv(o)) >= 0;
+  pthread_mutex_unlock(&heap_lock);
+  return shared;
+}
+
+object* osetcar(object* o, object value) {
+  share_evacuate(o);
+  if (cell_shared(o)) {
+    cell_unshare(o, false, true);
+  }
+  car(o) = value;
+  ogc_barrier(&car(o));
+  return o;
+}
+
+object* osetcdr(object* o, object* value) {
+  share_evacuate(o);
+  if (cell_shared(o)) {
+    cell_unshare(o, true, false);
+  }
+  if (ocdr_coded(o)) {
+    /* a coded cell has no cdr of its own, move it to a cell that does */
+    object* slot = oalloc();
+    cell* c = &oslot(slot)->cell;
+    c->car = car(o);
+    *slot = make_cell(c);
+    setcellv(o, c);
+    ogc_barrier(slot);
+  }
+  cellv(o)->cdr = value;
+  ogc_barrier(value);
+  return o;
+}
+
+object* cons(object a, object* b) {
+  object* o = oalloc();
+  cell* c = &oslot(o)->cell;
+  if (is(a, string)) {
+    c->car = string_copy(&a);
+  } else if (is(a, cell)) {
+    c->car = copy_on_write && share_spine(&a) ? a : *ocopy(&a);
+  } else {
+    c->car = a;
+  }
+  c->cdr = b;
+  *o = make_cell(c);
+  return o;
+}
+
+struct general_page* slab_page(struct general_page* next, struct general_region* region) {
+  void* memory = NULL;
+  if (posix_memalign(&memory, SLAB_PAGE_SIZE, SLAB_PAGE_SIZE) != 0) {
+    return NULL;
+  }
+  struct general_page* page = memory;
+  page->next = next;
+  page->region = region;
+  page->heap = region ? NULL : oheap();
+  page->used = 0;
+  memset(page->flags, 0, sizeof(page->flags));
+  slab_map_set(page, true);
+  return page;
+}
+
+struct general_slot* slab_alloc() {
+  struct general_heap* h = oheap();
+  if (!h->free_slots && __atomic_load_n(&h->remote, __ATOMIC_RELAXED)) {
+    heap_reclaim(h);
+  }
+  struct general_slot* s = h->free_slots;
+  if (s) {
+    h->free_slots = (struct general_slot*)s->cell.cdr;
+    return s;
+  }
+
+  if (!h->pages || h->pages->used >= SLAB_PAGE_SLOTS) {
+    h->pages = slab_page(h->pages, NULL);
+  }
+  return &h->pages->slots[h->pages->used++];
+}
+
+/**
+ * h->objects[to] = h->objects[from]
+ */
+void registry_move(struct general_heap* h, long int from, long int to) {
+  object* o = h->objects[from];
+  h->objects[to] = o;
+  opage(o)->index[oslot_index(o)] = to;
+}
+
+/**
+ * Take slot s out of h's registry and onto its free list.
+ */
+void heap_free(struct general_heap* h, struct general_slot* s) {
+  struct general_page* page = opage(s);
+  long int i = page->index[oslot_index(s)];
+  if (gc_phase == GC_SWEEP && i < h->sweep) {
+    /* keep everything below the mark unswept */
+    h->sweep--;
+    registry_move(h, h->sweep, i);
+    registry_move(h, h->count - 1, h->sweep);
+  } else {
+    registry_move(h, h->count - 1, i);
+  }
+  h->count--;
+  page->flags[oslot_index(s)] = 0;
+  if (__atomic_load_n(&shared_cells.count, __ATOMIC_RELAXED) ||
+      __atomic_load_n(&shared_joints.count, __ATOMIC_RELAXED)) {
+    pthread_mutex_lock(&heap_lock);
+    ptrset_remove(&shared_cells, &s->cell);
+    share_unjoin(&s->cell);
+    ptrmap_remove(&shared_joints, &s->obj);
+    pthread_mutex_unlock(&heap_lock);
+  }
+
+  s->cell.cdr = (object*)h->free_slots;
+  h->free_slots = s;
+}
+
+void slab_free(struct general_slot* s) {
+  struct general_heap* h = opage(s)->heap;
+  if (h == local_heap) {
+    heap_free(h, s);
+    return;
+  }
+  /* another thread's, taken back the next time it runs out of slots */
+  struct general_slot* head = __atomic_load_n(&h->remote, __ATOMIC_RELAXED);
+  do {
+    s->cell.cdr = (object*)head;
+  } while (!__atomic_compare_exchange_n(&h->remote, &head, s, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**
+ * Free the slots other threads pushed on h->remote, returns how many.
+ */
+long int heap_reclaim(struct general_heap* h) {
+  struct general_slot* s = __atomic_exchange_n(&h->remote, NULL, __ATOMIC_ACQUIRE);
+  long int c = 0;
+  while (s) {
+    struct general_slot* next = (struct general_slot*)s->cell.cdr;
+    heap_free(h, s);
+    s = next;
+    c++;
+  }
+  return c;
+}
+
+pthread_key_t heap_key;
+pthread_once_t heap_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Leave an exiting thread's heap for the next thread to adopt.
+ */
+void heap_abandon(void* heap) {
+  pthread_mutex_lock(&heap_lock);
+  ((struct general_heap*)heap)->abandoned = true;
+  __atomic_sub_fetch(&heaps_active, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&heap_lock);
+}
+
+void heap_key_create() {
+  pthread_key_create(&heap_key, heap_abandon);
+}
+
+struct general_heap* oheap() {
+  if (local_heap) {
+    return local_heap;
+  }
+  pthread_once(&heap_key_once, heap_key_create);
+  pthread_mutex_lock(&gc_lock);
+  pthread_mutex_lock(&heap_lock);
+  struct general_heap* h = heaps;
+  while (h && !h->abandoned) {
+    h = h->next;
+  }
+  if (h) {
+    h->abandoned = false;
+  } else {
+    h = calloc(1, sizeof(struct general_heap));
+    h->objects = malloc(sizeof(object*) * 50);
+    h->length = 50;
+    h->next = heaps;
+    __atomic_store_n(&heaps, h, __ATOMIC_RELEASE);
+  }
+  if (heaps_active && gc_phase != GC_IDLE) {
+    /* the other threads' barriers can't be part of it */
+    gc_abandon();
+  }
+  __atomic_add_fetch(&heaps_active, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&heap_lock);
+  pthread_mutex_unlock(&gc_lock);
+  pthread_setspecific(heap_key, h);
+  local_heap = h;
+  return h;
+}
+
+void heap_retire() {
+  if (local_heap) {
+    pthread_setspecific(heap_key, NULL);
+    heap_abandon(local_heap);
+    local_heap = NULL;
+  }
+}
+
+struct general_region* oregion_begin() {
+  struct general_region* r = malloc(sizeof(struct general_region));
+  r->parent = current_region;
+  r->pages = NULL;
+  r->chunks = NULL;
+  current_region = r;
+  return r;
+}
+
+void oregion_end(struct general_region* r) {
+  for (struct general_page* page = r->pages; page; ) {
+    struct general_page* next = page->next;
+    if (__atomic_load_n(&gc_phase, __ATOMIC_RELAXED) == GC_MARK) {
+      pthread_mutex_lock(&gc_lock);
+      gc_forget(page, (char*)page + SLAB_PAGE_SIZE);
+      pthread_mutex_unlock(&gc_lock);
+    }
+    slab_map_set(page, false);
+    free(page);
+    page = next;
+  }
+  for (struct general_chunk* chunk = r->chunks; chunk; ) {
+    struct general_chunk* next = chunk->next;
+    if (__atomic_load_n(&gc_phase, __ATOMIC_RELAXED) == GC_MARK) {
+      pthread_mutex_lock(&gc_lock);
+      gc_forget(chunk->bytes, chunk->bytes + chunk->size);
+      pthread_mutex_unlock(&gc_lock);
+    }
+    free(chunk);
+    chunk = next;
+  }
+  current_region = r->parent;
+  free(r);
+}
+
+struct general_slot* region_alloc(struct general_region* r) {
+  if (!r->pages || r->pages->used >= SLAB_PAGE_SLOTS) {
+    r->pages = slab_page(r->pages, r);
+  }
+  return &r->pages->slots[r->pages->used++];
+}
+
+/**
+ * Everything from here has a general_string header in front of it,
+ * which keeps it 8 byte aligned for vector items.
+ */
+string ostring_alloc(long int size) {
+  struct general_region* r = current_region;
+  struct general_string* header;
+  if (!r) {
+    header = malloc(sizeof(struct general_string) + size);
+    ptrset_add(&owned_strings, header->bytes);
+    if (__atomic_load_n(&gc_phase, __ATOMIC_RELAXED) != GC_IDLE) {
+      pthread_mutex_lock(&gc_lock);
+      if (gc_phase != GC_IDLE) {
+        gc_mark_string(header->bytes);
+      }
+      pthread_mutex_unlock(&gc_lock);
+    }
+  } else {
+    header = chunk_alloc(&r->chunks, sizeof(struct general_string) + size);
+  }
+  header->length = 0;
+  header->hash = 0;
+  return header->bytes;
+}
+
+void ostring_free(string s) {
+  if (s && ptrset_find(&owned_strings, s) >= 0) {
+    ptrset_remove(&owned_strings, s);
+    free(ostring_header(s));
+  }
+}
+
+string ostring_new(string s, long int length) {
+  string bytes = ostring_alloc(length + 1);
+  memcpy(bytes, s, length);
+  bytes[length] = '\0';
+  ostring_header(bytes)->length = length;
+  return bytes;
+}
+
+long int ostring_length(object* o) {
+  if (is(*o, string) && ostring_form(o) == STRING_HEAP) {
+    return ostring_header(stringv(o))->length;
+  } else if (is(*o, symbol)) {
+    return ostring_header(symbolv(o))->length;
+  }
+  string s = stringv(o);
+  return s ? strlen(s) : 0;
+}
+
+uint64_t ostring_hash(object* o) {
+  if (is(*o, symbol) || (is(*o, string) && ostring_form(o) == STRING_HEAP)) {
+    struct general_string* header = ostring_header(stringv(o));
+    if (!header->hash) {
+      uint64_t h = string_hash(header->bytes, header->length);
+      header->hash = h ? h : 1;
+    }
+    return header->hash;
+  }
+  uint64_t h = string_hash(stringv(o), ostring_length(o));
+  return h ? h : 1;
+}
+
+/**
+ * The value of string o with its characters copied into the current
+ * allocator. Small strings and symbols are shared as they are.
+ */
+object string_copy(object* o) {
+  if (is(*o, symbol) || (is(*o, string) && ostring_form(o) == STRING_SMALL)) {
+    return *o;
+  }
+  string s = stringv(o);
+  if (!s) {
+    return *o;
+  } else if (is(*o, error)) {
+    object copy = *o;
+    setstringv(&copy, ostring_new(s, strlen(s)));
+    return copy;
+  }
+  return string_value(ostring_new(s, ostring_length(o)));
+}
+
+object promote_value(object*);
+object* promote(object*);
+object* array_copy(object*);
+object* hashmap_copy(object*, object (*)(object*));
+object* unrolled_copy(object*, object (*)(object*));
+object* deque_copy(object*, object (*)(object*));
+
+/**
+ * Copy a vector into the current allocator, promoting each item.
+ */
+object* promote_vector(object* o) {
+  vector* v = vectorv(o);
+  object* copy = ovector(v->length);
+  for (int i = 0; i < v->length; i++) {
+    ovector_push(copy, promote_value(&v->items[i]));
+  }
+  return copy;
+}
+
+/**
+ * Copy a list spine into the current allocator, promoting each car.
+ */
+object* promote_list(object* o) {
+  object* head = NULL;
+  object** tail = &head;
+  while (is(*o, cell)) {
+    object* node = oalloc();
+    *node = make_cell(&oslot(node)->cell);
+    car(node) = promote_value(&car(o));
+    *tail = node;
+    tail = &cellv(node)->cdr;
+    o = cdr(o);
+  }
+  *tail = promote(o);
+  return head;
+}
+
+/**
+ * The value of o with its string and cells, cars included, copied
+ * into the current allocator.
+ */
+object promote_value(object* o) {
+  object copy = *o;
+  if (is(copy, string) || is(copy, error)) {
+    copy = string_copy(o);
+  } else if (is(copy, cell)) {
+    copy = *promote_list(o);
+  } else if (is(copy, vector)) {
+    copy = *promote_vector(o);
+  } else if (is(copy, ints) || is(copy, doubles)) {
+    copy = *array_copy(o);
+  } else if (is(copy, hashmap)) {
+    copy = *hashmap_copy(o, promote_value);
+  } else if (is(copy, unrolled)) {
+    copy = *unrolled_copy(o, promote_value);
+  } else if (is(copy, headed)) {
+    copy = *oheaded(promote(oheaded_list(o)));
+  } else if (is(copy, deque)) {
+    copy = *deque_copy(o, promote_value);
+  }
+  return copy;
+}
+
+object* promote(object* o) {
+  if (is(*o, t)) {
+    return T;
+  } else if (is(*o, nil)) {
+    return NIL;
+  } else if (is(*o, cell)) {
+    return promote_list(o);
+  } else if (is(*o, vector)) {
+    return promote_vector(o);
+  } else if (is(*o, ints) || is(*o, doubles)) {
+    return array_copy(o);
+  } else if (is(*o, hashmap)) {
+    return hashmap_copy(o, promote_value);
+  } else if (is(*o, unrolled)) {
+    return unrolled_copy(o, promote_value);
+  } else if (is(*o, headed)) {
+    return oheaded(promote(oheaded_list(o)));
+  } else if (is(*o, deque)) {
+    return deque_copy(o, promote_value);
+  }
+  object* copy = oalloc();
+  *copy = promote_value(o);
+  return copy;
+}
+
+object* opromote(object* o) {
+  struct general_region* r = current_region;
+  current_region = r ? r->parent : NULL;
+  object* copy = promote(o);
+  current_region = r;
+  return copy;
+}
+
+void registry_reserve(long int);
+
+/**
+ * Get ready for n global allocations: set up the registry, make room
+ * in it and let the collector do its share of work first.
+ */
+void oalloc_reserve(long int n) {
+  struct general_heap* h = oheap();
+  if (__atomic_load_n(&h->remote, __ATOMIC_RELAXED)) {
+    heap_reclaim(h);
+  }
+
+  if (__atomic_load_n(&heaps_active, __ATOMIC_RELAXED) > 1 ||
+      __atomic_load_n(&gc_held, __ATOMIC_RELAXED)) {
+    /* collecting is left to the program, or for later */
+  } else if ((gc_incremental && gc_phase != GC_IDLE) ||
+             (gc_threshold > 0 && gc_allocated >= gc_threshold)) {
+    pthread_mutex_lock(&gc_lock);
+    /* another thread may have taken a heap since */
+    if (heaps_active == 1) {
+      if (gc_incremental) {
+        gc_step();
+      } else {
+        gc_collect();
+      }
+    }
+    pthread_mutex_unlock(&gc_lock);
+  }
+  gc_allocated += n;
+  registry_reserve(n);
+}
+
+/**
+ * Make room in the registry for n more objects.
+ */
+void registry_reserve(long int n) {
+  struct general_heap* h = oheap();
+  if (h->count + n > h->length) {
+    long int new_size = h->length + h->length / 2;
+    if (new_size < h->count + n) {
+      new_size = h->count + n;
+    }
+    object** new_list = malloc(sizeof(object*) * new_size);
+    memcpy(new_list, h->objects, sizeof(object*) * h->length);
+    h->length = new_size;
+    object** old = h->objects;
+    free(old);
+    h->objects = new_list;
+  }
+}
+
+/**
+ * Mark slot s live, add it to the registry unless it is in a region
+ * and give it an int 0 header.
+ */
+object* oalloc_init(struct general_slot* s) {
+  object* x = &s->obj;
+  opage(x)->flags[oslot_index(x)] = SLOT_LIVE;
+  opage(x)->refs[oslot_index(x)] = 0;
+  if (!opage(x)->region) {
+    struct general_heap* h = opage(x)->heap;
+    opage(x)->index[oslot_index(x)] = h->count;
+    h->objects[h->count] = x;
+    h->count ++;
+  }
+
+  *x = make_int(0);
+  oslot(x)->cell.car = *x;
+  oslot(x)->cell.cdr = NIL;
+  return x;
+}
+
+object* oalloc() {
+  if (current_region) {
+    return oalloc_init(region_alloc(current_region));
+  }
+  oalloc_reserve(1);
+  return oalloc_init(slab_alloc());
+}
+
+void buffer_release(void*);
+void share_drop(object*);
+void hashmap_release(hashmap*);
+void unrolled_release(unrolled*);
+void compact_free(struct general_run*);
+
+int ofree(object* o) {
+  if (!o) {
+    return 0;
+  } else {
+    int c = 0;
+    object* next = NULL;
+    struct general_run* run = NULL;
+    struct general_run* entered = NULL;
+    object* first = o;
+    do {
+      next = NULL;
+      if (is(*o, cell)) {
+        next = cell_next(o);
+      }
+      struct general_page* page = slab_page_of(o);
+      if (o == NIL || o == T) {
+        /* static */
+      } else if (is(*o, cell) && cell_shared(o)) {
+        /* the rest is another list's as well, left to the collector */
+        share_drop(o);
+        if (page && !page->region && cellv(o) != &oslot(o)->cell) {
+          slab_free(oslot(o));
+          c += 1;
+        }
+        next = NULL;
+      } else if (__atomic_load_n(&compact_runs.count, __ATOMIC_RELAXED) &&
+                 !page && (run = compact_run_of(o))) {
+        /* freed whole, once walked from its first cell to its last */
+        struct general_packed* p = (struct general_packed*)o;
+        if (p == run->cells) {
+          entered = run;
+        }
+        if (p == &run->cells[run->length - 1] && entered == run) {
+          c += run->length;
+          compact_free(run);
+        }
+      } else if (!page) {
+        /* not allocated here, the rest may be */
+      } else if (__atomic_load_n(&refs_counted, __ATOMIC_RELAXED) && o != first && !page->region && orefs_word(o)) {
+        /* the rest has references of its own */
+        next = NULL;
+      } else if (page->region) {
+        /* released with its region */
+      } else {
+        if ((is(*o, string) || is(*o, error)) && ostring_form(o) != STRING_SMALL) {
+          ostring_free(stringv(o));
+        } else if (is(*o, cell) && is(car(o), string) &&
+                   ostring_form(&car(o)) == STRING_HEAP) {
+          /* cons() gave the cell its own copy */
+          ostring_free(stringv(&car(o)));
+        } else if (is(*o, vector) && vectorv(o) == (vector*)&oslot(o)->cell) {
+          buffer_release(vectorv(o)->items);
+        } else if ((is(*o, ints) || is(*o, doubles)) &&
+                   arrayv(o) == (array*)&oslot(o)->cell) {
+          buffer_release(arrayv(o)->data);
+        } else if (is(*o, hashmap) && hashmapv(o) == (hashmap*)&oslot(o)->cell) {
+          hashmap_release(hashmapv(o));
+        } else if (is(*o, unrolled) && unrolledv(o) == (unrolled*)&oslot(o)->cell) {
+          unrolled_release(unrolledv(o));
+        } else if (is(*o, headed)) {
+          c += ofree(oheaded_list(o));
+          buffer_release(headedv(o));
+        } else if (is(*o, deque) && dequev(o) == (deque*)&oslot(o)->cell) {
+          buffer_release(dequev(o)->ring);
+        }
+        slab_free(oslot(o));
+        c += 1;
+      }
+      o = next;
+    } while (o);
+
+    return c;
+  }
+}
+
+/**
+ * Running total for oadd() and ominus(), an int until a double is
+ * added.
+ */
+struct general_sum {
+  int iout;
+  double dout;
+  bool is_int;
+};
+
+/**
+ * total += sign * x
+ */
+void sum_add(struct general_sum* sum, object* x, int sign) {
+  if (is(*x, int)) {
+    sum->iout += sign * x->value.int_v;
+    sum->dout += sign * x->value.int_v;
+  } else if (is(*x, double)) {
+    sum->is_int = false;
+    sum->dout += sign * x->value.double_v;
+  } else {
+    ppo(*x);
+    //error
+  }
+}
+
+object sum_value(struct general_sum* sum) {
+  return sum->is_int ? make_int(sum->iout) : make_double(sum->dout);
+}
+
+object oadd_n(object* args, int n) {
+  struct general_sum sum = { 0, 0, true };
+  for (int i = 0; i < n; i++) {
+    sum_add(&sum, &args[i], 1);
+  }
+  return sum_value(&sum);
+}
+
+object oadd(object* args) {
+  if (is(*args, headed)) {
+    args = oheaded_list(args);
+  }
+  if (is(*args, ints) || is(*args, doubles)) {
+    return oarray_sum(args);
+  } else if (is(*args, vector)) {
+    return oadd_n(vectorv(args)->items, vectorv(args)->length);
+  }
+  struct general_sum sum = { 0, 0, true };
+  if (is(*args, unrolled)) {
+    ounrolled_for_each(elm, args) {
+      sum_add(&sum, elm, 1);
+    }
+    return sum_value(&sum);
+  } else if (is(*args, deque)) {
+    odeque_for_each(elm, args) {
+      sum_add(&sum, elm, 1);
+    }
+    return sum_value(&sum);
+  }
+  for (object* o = args; is(*o, cell); o = cdr(o)) {
+    sum_add(&sum, &car(o), 1);
+  }
+  return sum_value(&sum);
+}
+
+object ominus_n(object* args, int n) {
+  struct general_sum sum = { 0, 0, true };
+  for (int i = 0; i < n; i++) {
+    sum_add(&sum, &args[i], i == 0 && n > 1 ? 1 : -1);
+  }
+  return sum_value(&sum);
+}
+
+/**
+ * Subtract args, if only one, negate.
+ */
+object ominus(object* args) {
+  if (is(*args, headed)) {
+    args = oheaded_list(args);
+  }
+  if (is(*args, vector)) {
+    return ominus_n(vectorv(args)->items, vectorv(args)->length);
+  }
+  struct general_sum sum = { 0, 0, true };
+  if (is(*args, unrolled)) {
+    bool first = unrolledv(args)->length > 1;
+    ounrolled_for_each(elm, args) {
+      sum_add(&sum, elm, first ? 1 : -1);
+      first = false;
+    }
+    return sum_value(&sum);
+  } else if (is(*args, deque)) {
+    bool first = dequev(args)->ring->length > 1;
+    odeque_for_each(elm, args) {
+      sum_add(&sum, elm, first ? 1 : -1);
+      first = false;
+    }
+    return sum_value(&sum);
+  }
+  for (object* o = args; is(*o, cell); o = cdr(o)) {
+    sum_add(&sum, &car(o), o == args && is(*cdr(o), cell) ? 1 : -1);
+  }
+  return sum_value(&sum);
+}
+
+object olength(object* list) {
+  object* o = list;
+  int length = 0;
+  if (is(*o, nil)) {
+    return make_int(length);
+  } else if (is(*o, vector)) {
+    return make_int(vectorv(o)->length);
+  } else if (is(*o, ints) || is(*o, doubles)) {
+    return make_int(arrayv(o)->length);
+  } else if (is(*o, hashmap)) {
+    return make_int(ohashmap_count(o));
+  } else if (is(*o, unrolled)) {
+    return make_int(unrolledv(o)->length);
+  } else if (is(*o, headed)) {
+    return make_int(headedv(o)->length);
+  } else if (is(*o, deque)) {
+    return make_int(dequev(o)->ring->length);
+  }
+
+  while(is(*o, cell)) {
+    length++;
+    o = cdr(o);
+  }
+
+  if (is(*o, nil)) {
+    return make_int(length);
+  } else {
+    //error (1 2 . 3) scenario
+    return make_int(-1);
+  }
+}
+
+object* olast(object* list) {
+  object* last = list;
+  ofor_each(elm, head, list) {
+    last = head;
+  }
+  return last;
+}
+
+object* oappend(object* args) {
+  struct general_builder b = obuilder();
+  ofor_each(list, head, args) {
+    obuilder_add_list(&b, is(*list, headed) ? oheaded_list(list) : list);
+  }
+  return obuilder_finish(&b);
+}
+
+object* opop(object* list) {
+  if (cell_shared(list)) {
+    cell_unshare(list, true, true);
+  }
+  if (is(*list, headed)) {
+    struct general_builder* b = headedv(list);
+    if (!b->length) {
+      return NIL;
+    }
+    object* value = ocopy(&car(b->head));
+    b->head = ocdr(b->head);
+    if (!--b->length) {
+      b->last = NULL;
+    }
+    return value;
+  }
+  object* value = ocopy(&car(list));
+
+  object* next = cdr(list);
+  if (is(*next, cell) && cell_shared(next)) {
+    /* list takes the place of a cell another list has too */
+    osetcar(list, shared_car(next));
+    osetcdr(list, cdr(next));
+  } else if (is(*next, cell)) {
+    osetcar(list, car(cdr(list)));
+    osetcdr(list, cdr(cdr(list)));
+  } else {
+    *list = *NIL;
+  }
+  return value;
+}
+
+object* opush(object elm, object* list) {
+  if (is(*list, headed)) {
+    struct general_builder* b = headedv(list);
+    b->head = cons(elm, b->head);
+    ogc_barrier(b->head);
+    if (!b->length++) {
+      b->last = b->head;
+    }
+    return list;
+  }
+  if (cell_shared(list)) {
+    cell_unshare(list, true, true);
+  }
+  osetcdr(list, cons(car(list), cdr(list)));
+  osetcar(list, elm);
+  return list;
+}
+
+/* **************************************************************
+ * List building
+ * ************************************************************** */
+
+/**
+ * b->last, found again after opush_atomic() or opop_atomic() left it
+ * unknown.
+ */
+object* builder_last(struct general_builder* b) {
+  if (!b->last && is(*b->head, cell)) {
+    object* c = b->head;
+    while (is(*cdr(c), cell)) {
+      c = cdr(c);
+    }
+    b->last = c;
+  }
+  return b->last;
+}
+
+void obuilder_add(struct general_builder* b, object value) {
+  object* node = cons(value, NIL);
+  if (builder_last(b)) {
+    osetcdr(b->last, node);
+  } else {
+    b->head = node;
+  }
+  b->last = node;
+  b->length++;
+}
+
+void obuilder_add_list(struct general_builder* b, object* list) {
+  ofor_each(elm, head, list) {
+    obuilder_add(b, *elm);
+  }
+}
+
+void obuilder_splice(struct general_builder* b, struct general_builder* other) {
+  if (!builder_last(other)) {
+    return;
+  } else if (builder_last(b)) {
+    osetcdr(b->last, other->head);
+  } else {
+    b->head = other->head;
+  }
+  b->last = other->last;
+  b->length += other->length;
+  *other = obuilder();
+}
+
+object* obuilder_finish(struct general_builder* b) {
+  object* list = b->head;
+  *b = obuilder();
+  return list;
+}
+
+/* **************************************************************
+ * Headed lists
+ * ************************************************************** */
+
+object* oheaded(object* list) {
+  object* o = oalloc();
+  struct general_builder* b =
+    (struct general_builder*)ostring_alloc(sizeof(struct general_builder));
+  *b = obuilder();
+  b->head = list;
+  ofor_each(elm, head, list) {
+    b->last = head;
+    b->length++;
+  }
+  *o = make_headed(b);
+  return o;
+}
+
+object* oheaded_add(object* o, object value) {
+  struct general_builder* b = headedv(o);
+  obuilder_add(b, value);
+  ogc_barrier(b->head);
+  return o;
+}
+
+object* oheaded_append(object* o, object* list) {
+  struct general_builder* b = headedv(o);
+  obuilder_add_list(b, is(*list, headed) ? oheaded_list(list) : list);
+  ogc_barrier(b->head);
+  return o;
+}
+
+/**
+ * The headed list's last cell is unknown once threads push and pop
+ * concurrently, builder_last() finds it again.
+ */
+#define builder_forget_last(b)                                  \
+  do {                                                          \
+    if (__atomic_load_n(&(b)->last, __ATOMIC_RELAXED))          \
+      __atomic_store_n(&(b)->last, NULL, __ATOMIC_RELAXED);     \
+  } while (0)
+
+object* opush_atomic(object elm, object* list) {
+  struct general_builder* b = headedv(list);
+  object* node = cons(elm, NIL);
+  object* head = __atomic_load_n(&b->head, __ATOMIC_RELAXED);
+  do {
+    cellv(node)->cdr = head;
+  } while (!__atomic_compare_exchange_n(&b->head, &head, node, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  __atomic_add_fetch(&b->length, 1, __ATOMIC_RELAXED);
+  builder_forget_last(b);
+  ogc_barrier(node);
+  return list;
+}
+
+/**
+ * Start reading cells other threads may unlink: until epoch_exit()
+ * none of them is freed.
+ */
+void epoch_enter(struct general_heap* h) {
+  __atomic_store_n(&h->epoch, __atomic_load_n(&stack_epoch, __ATOMIC_ACQUIRE),
+                   __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(struct general_heap* h) {
+  __atomic_store_n(&h->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Move stack_epoch on if every thread inside opop_atomic() has seen
+ * the current one.
+ */
+void epoch_advance() {
+  unsigned long int e = __atomic_load_n(&stack_epoch, __ATOMIC_ACQUIRE);
+  for (struct general_heap* h = __atomic_load_n(&heaps, __ATOMIC_ACQUIRE); h; h = h->next) {
+    unsigned long int seen = __atomic_load_n(&h->epoch, __ATOMIC_SEQ_CST);
+    if (seen && seen != e) {
+      return;
+    }
+  }
+  __atomic_compare_exchange_n(&stack_epoch, &e, e + 1, false,
+                              __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+void limbo_free(struct general_limbo* l) {
+  for (long int i = 0; i < l->count; i++) {
+    slab_free(oslot(l->cells[i]));
+  }
+  l->count = 0;
+}
+
+void* array_room(void*, long int, long int*, size_t);
+
+/**
+ * Free cell c, just unlinked by h's thread, once no thread can be
+ * reading it: two epochs on from now, every thread that might have
+ * seen it has left opop_atomic().
+ */
+void epoch_retire(struct general_heap* h, object* c) {
+  unsigned long int e = __atomic_load_n(&stack_epoch, __ATOMIC_SEQ_CST);
+  struct general_limbo* l = &h->limbo[e % 3];
+  if (l->epoch != e) {
+    /* three epochs old, nobody is left from then */
+    limbo_free(l);
+    l->epoch = e;
+  }
+  l->cells = array_room(l->cells, l->count, &l->length, sizeof(object*));
+  l->cells[l->count++] = c;
+
+  if (l->count % 64 == 0) {
+    epoch_advance();
+    unsigned long int now = __atomic_load_n(&stack_epoch, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < 3; i++) {
+      if (h->limbo[i].count && h->limbo[i].epoch + 2 <= now) {
+        limbo_free(&h->limbo[i]);
+      }
+    }
+  }
+}
+
+object opop_atomic(object* list) {
+  struct general_builder* b = headedv(list);
+  struct general_heap* h = oheap();
+  epoch_enter(h);
+  object* head = __atomic_load_n(&b->head, __ATOMIC_ACQUIRE);
+  while (is(*head, cell) &&
+         !__atomic_compare_exchange_n(&b->head, &head, cdr(head), true,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+  }
+  if (!is(*head, cell)) {
+    epoch_exit(h);
+    return *NIL;
+  }
+  object value = car(head);
+  __atomic_sub_fetch(&b->length, 1, __ATOMIC_RELAXED);
+  builder_forget_last(b);
+  /* a region's cells go with the region, a compact run's to the collector */
+  struct general_page* page = slab_page_of(head);
+  if (page && !page->region) {
+    epoch_retire(h, head);
+  }
+  epoch_exit(h);
+  return value;
+}
+
+/**
+ * n cells linked in order, the collector gets its turn before the
+ * first one instead of between them. Fresh slots are bump allocated
+ * in address order, and the free list hands back a freed list's slots
+ * in reverse, so either way the cells sit side by side.
+ */
+object* list_alloc(long int n) {
+  object* head = NIL;
+  object** tail = &head;
+  if (n > 0 && !current_region) {
+    oalloc_reserve(n);
+  }
+  for (long int i = 0; i < n; i++) {
+    struct general_slot* s =
+      current_region ? region_alloc(current_region) : slab_alloc();
+    object* node = oalloc_init(s);
+    *node = make_cell(&s->cell);
+    *tail = node;
+    tail = &cellv(node)->cdr;
+  }
+  return head;
+}
+
+object* list_from_ints(const int* xs, long int n) {
+  object* list = list_alloc(n);
+  long int i = 0;
+  ofor_each(elm, head, list) {
+    *elm = make_int(xs[i++]);
+  }
+  return list;
+}
+
+object* list_from_doubles(const double* xs, long int n) {
+  object* list = list_alloc(n);
+  long int i = 0;
+  ofor_each(elm, head, list) {
+    *elm = make_double(xs[i++]);
+  }
+  return list;
+}
+
+object* list_from_objects(const object* xs, long int n) {
+  object* list = list_alloc(n);
+  long int i = 0;
+  ofor_each(elm, head, list) {
+    object x = xs[i++];
+    *elm = is(x, string) ? string_copy(&x) : x;
+  }
+  return list;
+}
+
+long int list_to_array(object* list, object* out, long int n) {
+  long int i = 0;
+  for (object* o = list; i < n && is(*o, cell); o = cdr(o)) {
+    out[i++] = car(o);
+  }
+  return i;
+}
+
+/* **************************************************************
+ * Shared lists
+ * ************************************************************** */
+
+/**
+ * Count each cell of o's spine as shared by one more list and its cdr
+ * as a joint, false if a cell can't be shared: coded, in a region, not
+ * in the slab, or with a cdr another shared cell holds too. The cells
+ * before it stay counted, which only costs them a copy later. A ring
+ * is counted once round.
+ */
+bool share_spine(object* o) {
+  object* x = o;
+  do {
+    struct general_page* page = slab_page_of(cellv(x));
+    if (ocdr_coded(x) || !page || page->region) {
+      return false;
+    }
+    x = cell_next(x);
+  } while (is(*x, cell) && cellv(x) != cellv(o));
+
+  bool shared = true;
+  pthread_mutex_lock(&heap_lock);
+  x = o;
+  do {
+    cell* c = cellv(x);
+    long int i = ptrset_find(&shared_cells, c);
+    if (i < 0) {
+      ptrset_add(&shared_cells, c);
+      i = ptrset_find(&shared_cells, c);
+    }
+    if (shared_cells.marks[i] < 255) {
+      shared_cells.marks[i]++;
+    }
+    x = cell_next(x);
+    if (is(*x, cell)) {
+      long int holder = ptrmap_find(&shared_joints, x);
+      if (holder >= 0 && holder != (long int)(uintptr_t)c) {
+        shared = false;
+        break;
+      }
+      ptrmap_add(&shared_joints, x, (long int)(uintptr_t)c);
+    }
+  } while (is(*x, cell) && cellv(x) != cellv(o));
+  pthread_mutex_unlock(&heap_lock);
+  return shared;
+}
+
+/**
+ * Forget c's cdr as a joint, under heap_lock.
+ */
+void share_unjoin(cell* c) {
+  if (shared_joints.count &&
+      ptrmap_find(&shared_joints, c->cdr) == (long int)(uintptr_t)c) {
+    ptrmap_remove(&shared_joints, c->cdr);
+  }
+}
+
+/**
+ * One list less shares the cells from o's down, as far as they are
+ * shared.
+ */
+void share_drop(object* o) {
+  pthread_mutex_lock(&heap_lock);
+  object* x = o;
+  do {
+    cell* c = cellv(x);
+    long int i = ptrset_find(&shared_cells, c);
+    if (i < 0) {
+      break;
+    }
+    if (shared_cells.marks[i] < 255 && !--shared_cells.marks[i]) {
+      ptrset_remove(&shared_cells, c);
+      if (!ocdr_coded(x)) {
+        share_unjoin(c);
+      }
+    }
+    x = cell_next(x);
+  } while (is(*x, cell) && cellv(x) != cellv(o));
+  pthread_mutex_unlock(&heap_lock);
+}
+
+/**
+ * Before o is changed: a shared cell that holds o as its cdr gets a
+ * copy of o instead, so the lists sharing the cell go on as they were.
+ * Only a handle taken before its list was shared reaches a joint.
+ */
+void share_evacuate(object* o) {
+  if (!__atomic_load_n(&shared_joints.count, __ATOMIC_RELAXED)) {
+    return;
+  }
+  pthread_mutex_lock(&heap_lock);
+  long int holder = ptrmap_find(&shared_joints, o);
+  if (holder >= 0) {
+    ptrmap_remove(&shared_joints, o);
+    if (ptrset_find(&shared_cells, (cell*)(uintptr_t)holder) < 0) {
+      holder = -1;
+    }
+  }
+  pthread_mutex_unlock(&heap_lock);
+  if (holder < 0) {
+    return;
+  }
+  object* copy = oalloc();
+  *copy = *o;
+  cell* c = (cell*)(uintptr_t)holder;
+  pthread_mutex_lock(&heap_lock);
+  c->cdr = copy;
+  ptrmap_add(&shared_joints, copy, holder);
+  pthread_mutex_unlock(&heap_lock);
+  ogc_barrier(copy);
+}
+
+/**
+ * The car of a shared cell for a cell of its own: a heap string is
+ * copied so each can be freed.
+ */
+object shared_car(object* o) {
+  object* x = &car(o);
+  if (is(*x, string) && ostring_form(x) == STRING_HEAP) {
+    return string_copy(x);
+  }
+  return *x;
+}
+
+/**
+ * Give o a cell of its own before it is written or walked. A header
+ * that has its own cell free takes that, otherwise it gets a new one
+ * the way a coded cell does. A kept cdr gets a header of its own too,
+ * so the next cell stays shared and the joint is never handed out.
+ */
+void cell_unshare(object* o, bool keep_car, bool keep_cdr) {
+  share_evacuate(o);
+  object* next = cell_next(o);
+  if (keep_cdr && is(*next, cell)) {
+    object* view = oalloc();
+    *view = *next;
+    next = view;
+  }
+  struct general_page* page = slab_page_of(o);
+  cell* c = NULL;
+  if (page && o == &page->slots[oslot_index(o)].obj && &oslot(o)->cell != cellv(o)) {
+    c = &oslot(o)->cell;
+  } else {
+    object* slot = oalloc();
+    c = &oslot(slot)->cell;
+    *slot = make_cell(c);
+  }
+  c->car = keep_car ? shared_car(o) : car(o);
+  c->cdr = next;
+  *o = make_cell(c);
+  if (__atomic_load_n(&gc_phase, __ATOMIC_RELAXED) == GC_MARK) {
+    pthread_mutex_lock(&gc_lock);
+    if (gc_phase == GC_MARK) {
+      gc_shade_cell(c);
+    }
+    pthread_mutex_unlock(&gc_lock);
+  }
+}
+
+/**
+ * ocdr() while lists are shared: a header on a shared cell takes one
+ * of its own on the way past, so what it leads to is its list's alone.
+ */
+object* share_next(object* o) {
+  if (cell_shared(o)) {
+    cell_unshare(o, true, true);
+  }
+  return cell_next(o);
+}
+
+object* list_copy(object*);
+
+object* oshare(object* o) {
+  if (!is(*o, cell)) {
+    return ocopy(o);
+  } else if (!share_spine(o)) {
+    return list_copy(o);
+  }
+  object* copy = oalloc();
+  *copy = *o;
+  return copy;
+}
+
+/* **************************************************************
+ * Compact lists
+ * ************************************************************** */
+
+/**
+ * Where the run's tail pointer goes, right after its last car.
+ */
+#define compact_tail(run) ((object**)&(run)->cells[(run)->length].obj)
+
+/**
+ * Most cells a run can hold.
+ */
+#define RUN_MAX_CELLS                                                   \
+  ((RUN_MAX_SIZE - sizeof(struct general_run) - sizeof(object*)) /      \
+   sizeof(struct general_packed))
+
+struct general_run* compact_alloc(int length) {
+  long int needed = sizeof(struct general_run) +
+    sizeof(struct general_packed) * length + sizeof(object*);
+  int size = RUN_MIN_SIZE;
+  while (size < needed) {
+    size *= 2;
+  }
+  void* memory = NULL;
+  if (posix_memalign(&memory, size, size) != 0) {
+    return NULL;
+  }
+  struct general_run* run = memory;
+  run->size = size;
+  run->length = length;
+  pthread_mutex_lock(&heap_lock);
+  ptrset_add(&compact_runs, run);
+  if (gc_phase != GC_IDLE) {
+    compact_runs.marks[ptrset_find(&compact_runs, run)] = gc_epoch;
+  }
+  pthread_mutex_unlock(&heap_lock);
+  return run;
+}
+
+void compact_free(struct general_run* run) {
+  for (int i = 0; i < run->length; i++) {
+    object* car = &run->cells[i].car;
+    if (is(*car, string) && ostring_form(car) == STRING_HEAP) {
+      ostring_free(stringv(car));
+    }
+  }
+  if (__atomic_load_n(&gc_phase, __ATOMIC_RELAXED) == GC_MARK) {
+    pthread_mutex_lock(&gc_lock);
+    gc_forget(run, (char*)run + run->size);
+    pthread_mutex_unlock(&gc_lock);
+  }
+  pthread_mutex_lock(&heap_lock);
+  ptrset_remove(&compact_runs, run);
+  pthread_mutex_unlock(&heap_lock);
+  free(run);
+}
+
+struct general_run* compact_run_find(void* p) {
+  for (uintptr_t size = RUN_MIN_SIZE; size <= RUN_MAX_SIZE; size *= 2) {
+    struct general_run* run = (struct general_run*)((uintptr_t)p & ~(size - 1));
+    if (ptrset_find(&compact_runs, run) >= 0) {
+      return (char*)p < (char*)run + run->size ? run : NULL;
+    }
+  }
+  return NULL;
+}
+
+struct general_run* compact_run_of(void* p) {
+  if (!__atomic_load_n(&compact_runs.count, __ATOMIC_RELAXED)) {
+    return NULL;
+  }
+  pthread_mutex_lock(&heap_lock);
+  struct general_run* run = compact_run_find(p);
+  pthread_mutex_unlock(&heap_lock);
+  return run;
+}
+
+object* ocompact(object* list) {
+  struct general_region* r = current_region;
+  current_region = NULL;
+  object* head = NIL;
+  object** tail = &head;
+  object* o = list;
+  while (is(*o, cell)) {
+    int length = 0;
+    for (object* p = o; is(*p, cell) && length < (int)RUN_MAX_CELLS; p = cdr(p)) {
+      length++;
+    }
+    struct general_run* run = compact_alloc(length);
+    for (int i = 0; i < length; i++, o = cdr(o)) {
+      struct general_packed* p = &run->cells[i];
+      p->car = is(car(o), string) ? string_copy(&car(o)) : car(o);
+      p->obj = i + 1 < length ? make_coded_cell((cell*)&p->car) : make_cell((cell*)&p->car);
+    }
+    *tail = &run->cells[0].obj;
+    tail = compact_tail(run);
+  }
+  *tail = o;
+  current_region = r;
+  return head;
+}
+
+object* onumber_equal(object* a, object* b) {
+  if (is(*a, int) && is(*b, int)) {
+    return booly(intv(a) == intv(b));
+  } else {
+    double ad = numberv(*a);
+    double bd = numberv(*b);
+    return booly(ad == bd);
+  }
+  return NIL;
+}
+
+object* ostring_equal(object* a, object* b) {
+  if (stringv(a) == stringv(b)) {
+    return T;
+  } else if (is(*a, symbol) && is(*b, symbol)) {
+    return NIL;
+  }
+  long int length = ostring_length(a);
+  if (length != ostring_length(b)) {
+    return NIL;
+  }
+  return booly(memcmp(stringv(a), stringv(b), length) == 0);
+}
+
+object* ocopy(object* o) {
+  if (copy_on_write && is(*o, cell)) {
+    return oshare(o);
+  } else if (is(*o, t)) {
+    return T;
+  } else if (is(*o, nil)) {
+    return NIL;
+  } else if (is(*o, vector)) {
+    return ovector_slice(o, 0, vectorv(o)->length);
+  } else if (is(*o, ints) || is(*o, doubles)) {
+    return array_copy(o);
+  } else if (is(*o, hashmap)) {
+    return hashmap_copy(o, NULL);
+  } else if (is(*o, unrolled)) {
+    return unrolled_copy(o, NULL);
+  } else if (is(*o, headed)) {
+    return oheaded(ocopy(oheaded_list(o)));
+  } else if (is(*o, deque)) {
+    return deque_copy(o, NULL);
+  }
+
+  if (is(*o, cell)) {
+    return list_copy(o);
+  }
+  object* copy = oalloc();
+  *copy = is(*o, string) ? string_copy(o) : *o;
+  return copy;
+}
+
+/**
+ * ocopy() of a list: its spine is copied, its cars are shared.
+ */
+object* list_copy(object* o) {
+  object* copy = oalloc();
+  /* a loop rather than recursion, long lists would use up the stack */
+  object* node = copy;
+  while (true) {
+    cell* c = &oslot(node)->cell;
+    *node = make_cell(c);
+    c->car = car(o);
+    o = cdr(o);
+    if (!is(*o, cell)) {
+      c->cdr = ocopy(o);
+      ogc_barrier(c->cdr);
+      break;
+    }
+    c->cdr = oalloc();
+    ogc_barrier(c->cdr);
+    node = c->cdr;
+  }
+  return copy;
+}
+
+/**
+ * Room for one more element of size bytes in a growable array.
+ */
+void* array_room(void* array, long int count, long int* length, size_t size) {
+  if (count >= *length) {
+    *length = *length ? *length * 2 : 256;
+    array = realloc(array, size * *length);
+  }
+  return array;
+}
+
+/**
+ * True for a cdr that isn't a cell, NIL or T, which gets a slot of
+ * its own in a deep copy.
+ */
+#define deep_tail(o) (!is(*(o), cell) && (o) != NIL && (o) != T)
+
+object* ocopy_deep(object* o) {
+  if (!is(*o, cell)) {
+    return ocopy(o);
+  }
+  struct general_ptrmap numbers = { 0 };
+  object* nodes = NULL;
+  long int count = 0, nodes_length = 0;
+  object* stack = NULL;
+  long int depth = 0, stack_length = 0;
+  long int tails = 0;
+
+  /* number each cell once, along each cdr before the cars it passes */
+  stack = array_room(stack, depth, &stack_length, sizeof(object));
+  stack[depth++] = *o;
+  while (depth) {
+    object ref = stack[--depth];
+    while (ptrmap_find(&numbers, cellv(&ref)) < 0) {
+      nodes = array_room(nodes, count, &nodes_length, sizeof(object));
+      nodes[count] = ref;
+      ptrmap_add(&numbers, cellv(&ref), count++);
+      object* x = &car(&ref);
+      if (is(*x, cell)) {
+        stack = array_room(stack, depth, &stack_length, sizeof(object));
+        stack[depth++] = *x;
+      }
+      object* next = cell_next(&ref);
+      if (!is(*next, cell)) {
+        tails += deep_tail(next);
+        break;
+      }
+      ref = *next;
+    }
+  }
+
+  long int n = count + tails;
+  object** copies = malloc(sizeof(object*) * n);
+  if (!current_region) {
+    gc_allocated += n;
+    registry_reserve(n);
+  }
+  for (long int i = 0; i < n; i++) {
+    copies[i] = oalloc_init(current_region ? region_alloc(current_region) : slab_alloc());
+  }
+
+  long int t = count;
+  for (long int i = 0; i < count; i++) {
+    cell* c = &oslot(copies[i])->cell;
+    *copies[i] = make_cell(c);
+    object* x = &car(&nodes[i]);
+    if (is(*x, cell)) {
+      long int j = ptrmap_find(&numbers, cellv(x));
+      c->car = make_cell(&oslot(copies[j])->cell);
+    } else if (is(*x, string)) {
+      c->car = string_copy(x);
+    } else {
+      c->car = *x;
+    }
+    object* next = cell_next(&nodes[i]);
+    if (is(*next, cell)) {
+      c->cdr = copies[ptrmap_find(&numbers, cellv(next))];
+    } else if (deep_tail(next)) {
+      c->cdr = copies[t++];
+      *c->cdr = is(*next, string) ? string_copy(next) : *next;
+    } else {
+      c->cdr = next;
+    }
+  }
+
+  object* copy = copies[0];
+  ptrmap_free(&numbers);
+  free(nodes);
+  free(stack);
+  free(copies);
+  return copy;
+}
+
+object* oequal_n(object* args, int n) {
+  for (int i = 0; i + 1 < n; i++) {
+    if (!is(*oequal(&args[i], &args[i + 1]), t)) {
+      return NIL;
+    }
+  }
+  return T;
+}
+
+object* oequal(object* a, object* b) {
+  if (is_number(a) && is_number(b)) {
+
+    return onumber_equal(a, b);
+
+  } else if ((is(*a, string) || is(*a, symbol)) && (is(*b, string) || is(*b, symbol))) {
+
+    return ostring_equal(a, b);
+
+  } else {
+
+    if (otag(*a) != otag(*b)) {
+      return NIL;
+    }
+
+    switch (otag(*a)) {
+    case string_ot:
+      return ostring_equal(a, b);
+    case byte_ot:
+      return booly(bytev(a) == bytev(b));
+    case error_ot:
+      return ostring_equal(a, b);
+      return NIL;
+    case nil_ot:
+      return T;
+    case t_ot:
+      return T;
+    case cell_ot: {
+      /* along the cdrs in a loop, long lists would use up the stack */
+      while (is(*a, cell) && is(*b, cell)) {
+        if (!is(*oequal(&car(a), &car(b)), t)) {
+          return NIL;
+        }
+        a = cell_next(a);
+        b = cell_next(b);
+      }
+      return oequal(a, b);
+    }
+    case vector_ot: {
+      vector* va = vectorv(a);
+      vector* vb = vectorv(b);
+      if (va->length != vb->length) {
+        return NIL;
+      }
+      for (int i = 0; i < va->length; i++) {
+        if (!is(*oequal(&va->items[i], &vb->items[i]), t)) {
+          return NIL;
+        }
+      }
+      return T;
+    }
+    case ints_ot:
+    case doubles_ot: {
+      array* aa = arrayv(a);
+      array* ab = arrayv(b);
+      if (aa->length != ab->length) {
+        return NIL;
+      }
+      for (int i = 0; i < aa->length; i++) {
+        object x = oarray_ref(a, i);
+        object y = oarray_ref(b, i);
+        if (!is(*onumber_equal(&x, &y), t)) {
+          return NIL;
+        }
+      }
+      return T;
+    }
+    case hashmap_ot: {
+      if (ohashmap_count(a) != ohashmap_count(b)) {
+        return NIL;
+      }
+      ohashmap_for_each(key, value, a) {
+        object* other = ohashmap_get(b, key);
+        if (!other || !is(*oequal(value, other), t)) {
+          return NIL;
+        }
+      }
+      return T;
+    }
+    case headed_ot:
+      if (headedv(a)->length != headedv(b)->length) {
+        return NIL;
+      }
+      return oequal(oheaded_list(a), oheaded_list(b));
+    case deque_ot: {
+      struct general_ring* ra = dequev(a)->ring;
+      struct general_ring* rb = dequev(b)->ring;
+      if (ra->length != rb->length) {
+        return NIL;
+      }
+      for (int i = 0; i < ra->length; i++) {
+        if (!is(*oequal(deque_item(ra, i), deque_item(rb, i)), t)) {
+          return NIL;
+        }
+      }
+      return T;
+    }
+    case unrolled_ot: {
+      if (unrolledv(a)->length != unrolledv(b)->length) {
+        return NIL;
+      }
+      struct general_block* other = unrolledv(b)->first;
+      int j = 0;
+      ounrolled_for_each(elm, a) {
+        if (j == other->count) {
+          other = other->next;
+          j = 0;
+        }
+        if (!is(*oequal(elm, &other->items[other->start + j++]), t)) {
+          return NIL;
+        }
+      }
+      return T;
+    }
+    default:
+      return NIL;
+    }
+  }
+}
+
+
+/**
+ * Fold v into h, a multiply and xor-shift in the style of splitmix64.
+ */
+uint64_t hash_mix(uint64_t h, uint64_t v) {
+  h = (h ^ v) * 0x9e3779b97f4a7c15ull;
+  return h ^ (h >> 32);
+}
+
+/**
+ * Numbers hash by value, so an integral double hashes like the int
+ * it is onumber_equal() to.
+ */
+uint64_t hash_number(double d) {
+  if (d > -9.2e18 && d < 9.2e18 && d == (double)(int64_t)d) {
+    return hash_mix(int_ot, (uint64_t)(int64_t)d);
+  }
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  return hash_mix(double_ot, bits);
+}
+
+uint64_t hash_atom(object* o) {
+  switch (otag(*o)) {
+  case int_ot:
+    return hash_mix(int_ot, (uint64_t)(int64_t)intv(o));
+  case double_ot:
+    return hash_number(doublev(o));
+  case string_ot:
+  case symbol_ot:
+    return hash_mix(string_ot, ostring_hash(o));
+  case error_ot:
+    return hash_mix(error_ot, ostring_hash(o));
+  case byte_ot:
+    return hash_mix(byte_ot, (uint64_t)bytev(o));
+  case vector_ot: {
+    vector* v = vectorv(o);
+    uint64_t h = hash_mix(vector_ot, v->length);
+    for (int i = 0; i < v->length; i++) {
+      h = hash_mix(h, ohash(&v->items[i]));
+    }
+    return h;
+  }
+  case ints_ot: {
+    uint64_t h = hash_mix(ints_ot, arrayv(o)->length);
+    for (int i = 0; i < arrayv(o)->length; i++) {
+      h = hash_mix(h, hash_mix(int_ot, (uint64_t)(int64_t)intsv(o)[i]));
+    }
+    return h;
+  }
+  case doubles_ot: {
+    uint64_t h = hash_mix(doubles_ot, arrayv(o)->length);
+    for (int i = 0; i < arrayv(o)->length; i++) {
+      h = hash_mix(h, hash_number(doublesv(o)[i]));
+    }
+    return h;
+  }
+  case hashmap_ot: {
+    /* summed so the order of the entries doesn't matter */
+    uint64_t h = 0;
+    ohashmap_for_each(key, value, o) {
+      h += hash_mix(ohash(key), ohash(value));
+    }
+    return hash_mix(hashmap_ot, h);
+  }
+  case headed_ot:
+    return hash_mix(headed_ot, ohash(oheaded_list(o)));
+  case deque_ot: {
+    uint64_t h = hash_mix(deque_ot, dequev(o)->ring->length);
+    odeque_for_each(elm, o) {
+      h = hash_mix(h, ohash(elm));
+    }
+    return h;
+  }
+  case unrolled_ot: {
+    uint64_t h = hash_mix(unrolled_ot, unrolledv(o)->length);
+    ounrolled_for_each(elm, o) {
+      h = hash_mix(h, ohash(elm));
+    }
+    return h;
+  }
+  default:
+    return hash_mix(otag(*o), 0);
+  }
+}
+
+uint64_t ohash(object* o) {
+  uint64_t h = cell_ot;
+  bool list = false;
+  while (is(*o, cell)) {
+    h = hash_mix(h, ohash(&car(o)));
+    o = cdr(o);
+    list = true;
+  }
+  return list ? hash_mix(h, hash_atom(o)) : hash_atom(o);
+}
+
+void pl_internal(object*, bool);
+
+/**
+ * Pretty Print Object.
+ */
+void ppo(object o) {
+  printf("object <%s>\n  value: ", tag_string(otag(o)));
+  switch(otag(o))
+    {
+    case int_ot:
+      printf("%d", o.value.int_v);
+      break;
+    case double_ot:
+      printf("%f", o.value.double_v);
+      break;
+    case string_ot:
+      fwrite(stringv(&o), 1, ostring_length(&o), stdout);
+      break;
+    case byte_ot:
+      printf("%#1x", o.value.byte_v);
+      break;
+    case error_ot:
+      printf("%s", stringv(&o));
+      break;
+    case symbol_ot:
+      printf("%s", symbolv(&o));
+      break;
+    case nil_ot:
+      printf("nil");
+      break;
+    case t_ot:
+      printf("nil");
+      break;
+    case cell_ot:
+      printf("car: \n");
+      ppo(cellv((&o))->car);
+      break;
+    case vector_ot:
+    case ints_ot:
+    case doubles_ot:
+    case hashmap_ot:
+    case unrolled_ot:
+    case headed_ot:
+    case deque_ot:
+      pl_internal(&o, true);
+      break;
+    default:
+      printf("???");
+    }
+  putchar('\n');
+}
+
+/**
+ * Print one car or item.
+ */
+void pl_value(object* elm) {
+  switch(otag(*elm))
+    {
+    case int_ot:
+      printf("%d", elm->value.int_v);
+      break;
+    case double_ot:
+      printf("%f", elm->value.double_v);
+      break;
+    case string_ot:
+      fwrite(stringv(elm), 1, ostring_length(elm), stdout);
+      break;
+    case byte_ot:
+      printf("%#1x", elm->value.byte_v);
+      break;
+    case error_ot:
+      printf("%s", stringv(elm));
+      break;
+    case symbol_ot:
+      printf("%s", symbolv(elm));
+      break;
+    case nil_ot:
+      printf("nil");
+      break;
+    case t_ot:
+      printf("t");
+      break;
+    case cell_ot:
+    case vector_ot:
+    case ints_ot:
+    case doubles_ot:
+    case hashmap_ot:
+    case unrolled_ot:
+    case headed_ot:
+    case deque_ot:
+      pl_internal(elm, true);
+      break;
+    default:
+      printf("???");
     }
-  putchar('\n');
 }
 
 void pl_internal(object* o, bool inside) {
-  putchar('(');
-  ofor_each(elm, head, o) {
-    switch(elm->tag)
-      {
-      case int_ot:
-        printf("%d", elm->value.int_v);
-        break;
-      case double_ot:
-        printf("%f", elm->value.double_v);
-        break;
-      case string_ot:
-        printf("%s", elm->value.string_v);
-        break;
-      case byte_ot:
-        printf("%#1x", elm->value.byte_v);
-        break;
-      case error_ot:
-        printf("%s", elm->value.string_v);
-        break;
-      case nil_ot:
-        printf("nil");
-        break;
-      case t_ot:
-        printf("t");
-        break;
-      case cell_ot:
-        pl_internal(elm, true);
-        break;
-      default:
-        printf("???");
+  if (is(*o, headed)) {
+    o = oheaded_list(o);
+  }
+  if (is(*o, vector)) {
+    putchar('[');
+    for (int i = 0; i < vectorv(o)->length; i++) {
+      pl_value(&vectorv(o)->items[i]);
+      if (i + 1 < vectorv(o)->length) {
+        printf(", ");
+      }
+    }
+    putchar(']');
+  } else if (is(*o, hashmap)) {
+    putchar('{');
+    int left = ohashmap_count(o);
+    ohashmap_for_each(key, value, o) {
+      pl_value(key);
+      printf(": ");
+      pl_value(value);
+      if (--left) {
+        printf(", ");
+      }
+    }
+    putchar('}');
+  } else if (is(*o, unrolled)) {
+    putchar('<');
+    long int left = unrolledv(o)->length;
+    ounrolled_for_each(elm, o) {
+      pl_value(elm);
+      if (--left) {
+        printf(", ");
+      }
+    }
+    putchar('>');
+  } else if (is(*o, deque)) {
+    printf("#(");
+    int left = dequev(o)->ring->length;
+    odeque_for_each(elm, o) {
+      pl_value(elm);
+      if (--left) {
+        printf(", ");
+      }
+    }
+    putchar(')');
+  } else if (is(*o, ints) || is(*o, doubles)) {
+    printf("#[");
+    for (int i = 0; i < arrayv(o)->length; i++) {
+      object x = oarray_ref(o, i);
+      pl_value(&x);
+      if (i + 1 < arrayv(o)->length) {
+        printf(", ");
+      }
+    }
+    putchar(']');
+  } else {
+    putchar('(');
+    ofor_each(elm, head, o) {
+      pl_value(elm);
+      if (!is(*cdr(head), nil)) {
+        printf(", ");
+      }
+    }
+    putchar(')');
+  }
+  if (!inside) {
+    putchar('\n');
+  }
+}
+
+void pl(object* o) {
+  pl_internal(o, false);
+}
+
+/* **************************************************************
+ * Vectors
+ * ************************************************************** */
+
+/**
+ * Let go of a vector's items or an array's elements. While marking
+ * the collector may have pointers into them queued, so they are left
+ * for the sweep.
+ */
+void buffer_release(void* buffer) {
+  if (gc_phase != GC_MARK) {
+    ostring_free(buffer);
+  }
+}
+
+void vector_grow(vector* v, int capacity) {
+  object* items = (object*)ostring_alloc(sizeof(object) * capacity);
+  memcpy(items, v->items, sizeof(object) * v->length);
+  buffer_release(v->items);
+  v->items = items;
+  v->capacity = capacity;
+}
+
+object* ovector(int capacity) {
+  object* o = oalloc();
+  vector* v = (vector*)&oslot(o)->cell;
+  opage(o)->flags[oslot_index(o)] |= SLOT_VECTOR;
+  v->length = 0;
+  v->capacity = capacity > 4 ? capacity : 4;
+  v->items = (object*)ostring_alloc(sizeof(object) * v->capacity);
+  *o = make_vector(v);
+  return o;
+}
+
+object* ovector_from_list(object* list) {
+  object* o = ovector(olength(list).value.int_v);
+  ofor_each(elm, head, list) {
+    ovector_push(o, *elm);
+  }
+  return o;
+}
+
+object* ovector_to_list(object* o) {
+  vector* v = vectorv(o);
+  object* head = NIL;
+  object** tail = &head;
+  for (int i = 0; i < v->length; i++) {
+    object* node = oalloc();
+    *node = make_cell(&oslot(node)->cell);
+    car(node) = v->items[i];
+    *tail = node;
+    ogc_barrier(node);
+    tail = &cellv(node)->cdr;
+  }
+  return head;
+}
+
+object* ovector_ref(object* o, int i) {
+  vector* v = vectorv(o);
+  if (i < 0 || i >= v->length) {
+    return NIL;
+  }
+  return &v->items[i];
+}
+
+object* ovector_set(object* o, int i, object value) {
+  vector* v = vectorv(o);
+  if (i < 0 || i >= v->length) {
+    return NIL;
+  }
+  v->items[i] = value;
+  ogc_barrier(&v->items[i]);
+  return o;
+}
+
+object* ovector_push(object* o, object value) {
+  vector* v = vectorv(o);
+  if (v->length >= v->capacity) {
+    vector_grow(v, v->capacity * 2);
+  }
+  v->items[v->length] = value;
+  ogc_barrier(&v->items[v->length]);
+  v->length++;
+  return o;
+}
+
+object* ovector_slice(object* o, int start, int end) {
+  vector* v = vectorv(o);
+  start = start < 0 ? 0 : start;
+  end = end > v->length ? v->length : end;
+  int length = end > start ? end - start : 0;
+
+  object* slice = ovector(length);
+  if (length) {
+    memcpy(vectorv(slice)->items, v->items + start, sizeof(object) * length);
+  }
+  vectorv(slice)->length = length;
+  return slice;
+}
+
+/* **************************************************************
+ * Numeric arrays
+ * ************************************************************** */
+
+/**
+ * Kernels do a SIMD register's worth of elements at a time with GCC
+ * vector types, then the tail one at a time. On x86-64 each kernel is
+ * built for AVX2 and for the SSE2 baseline and the loader picks one
+ * for the CPU. Build with GENERAL_NO_SIMD for the scalar loops only.
+ */
+#ifdef GENERAL_NO_SIMD
+#define ARRAY_SIMD 0
+#else
+#define ARRAY_SIMD 1
+#endif
+
+#if defined(__x86_64__) && !defined(GENERAL_NO_SIMD)
+#define ARRAY_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define ARRAY_KERNEL
+#endif
+
+/* int math is done unsigned so overflow wraps like it does in oadd() */
+typedef unsigned int simd_uints __attribute__((vector_size(32)));
+typedef int simd_ints __attribute__((vector_size(32)));
+typedef int simd_ints4 __attribute__((vector_size(16)));
+typedef double simd_doubles __attribute__((vector_size(32)));
+typedef long long int simd_mask __attribute__((vector_size(32)));
+
+ARRAY_KERNEL
+int kernel_sum_ints(const int* x, long int n) {
+  long int i = 0;
+  simd_uints acc = { 0 };
+  for (; ARRAY_SIMD && i + 8 <= n; i += 8) {
+    simd_uints v;
+    memcpy(&v, x + i, sizeof(v));
+    acc += v;
+  }
+  unsigned int sum = 0;
+  for (int j = 0; j < 8; j++) {
+    sum += acc[j];
+  }
+  for (; i < n; i++) {
+    sum += x[i];
+  }
+  return sum;
+}
+
+ARRAY_KERNEL
+double kernel_sum_doubles(const double* x, long int n) {
+  long int i = 0;
+  simd_doubles acc = { 0 };
+  for (; ARRAY_SIMD && i + 4 <= n; i += 4) {
+    simd_doubles v;
+    memcpy(&v, x + i, sizeof(v));
+    acc += v;
+  }
+  double sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  for (; i < n; i++) {
+    sum += x[i];
+  }
+  return sum;
+}
+
+/**
+ * Smallest and largest of n > 0 elements.
+ */
+ARRAY_KERNEL
+void kernel_minmax_ints(const int* x, long int n, int* min, int* max) {
+  long int i = 1;
+  int lo = x[0];
+  int hi = x[0];
+  if (ARRAY_SIMD && n >= 8) {
+    simd_ints vlo;
+    memcpy(&vlo, x, sizeof(vlo));
+    simd_ints vhi = vlo;
+    for (i = 8; i + 8 <= n; i += 8) {
+      simd_ints v;
+      memcpy(&v, x + i, sizeof(v));
+      simd_ints lt = v < vlo;
+      simd_ints gt = v > vhi;
+      vlo = (v & lt) | (vlo & ~lt);
+      vhi = (v & gt) | (vhi & ~gt);
+    }
+    for (int j = 0; j < 8; j++) {
+      lo = vlo[j] < lo ? vlo[j] : lo;
+      hi = vhi[j] > hi ? vhi[j] : hi;
+    }
+  }
+  for (; i < n; i++) {
+    lo = x[i] < lo ? x[i] : lo;
+    hi = x[i] > hi ? x[i] : hi;
+  }
+  *min = lo;
+  *max = hi;
+}
+
+ARRAY_KERNEL
+void kernel_minmax_doubles(const double* x, long int n, double* min, double* max) {
+  long int i = 1;
+  double lo = x[0];
+  double hi = x[0];
+  if (ARRAY_SIMD && n >= 4) {
+    simd_doubles vlo;
+    memcpy(&vlo, x, sizeof(vlo));
+    simd_doubles vhi = vlo;
+    for (i = 4; i + 4 <= n; i += 4) {
+      simd_doubles v;
+      memcpy(&v, x + i, sizeof(v));
+      simd_mask lt = v < vlo;
+      simd_mask gt = v > vhi;
+      vlo = (simd_doubles)(((simd_mask)v & lt) | ((simd_mask)vlo & ~lt));
+      vhi = (simd_doubles)(((simd_mask)v & gt) | ((simd_mask)vhi & ~gt));
+    }
+    for (int j = 0; j < 4; j++) {
+      lo = vlo[j] < lo ? vlo[j] : lo;
+      hi = vhi[j] > hi ? vhi[j] : hi;
+    }
+  }
+  for (; i < n; i++) {
+    lo = x[i] < lo ? x[i] : lo;
+    hi = x[i] > hi ? x[i] : hi;
+  }
+  *min = lo;
+  *max = hi;
+}
+
+ARRAY_KERNEL
+int kernel_dot_ints(const int* a, const int* b, long int n) {
+  long int i = 0;
+  simd_uints acc = { 0 };
+  for (; ARRAY_SIMD && i + 8 <= n; i += 8) {
+    simd_uints va, vb;
+    memcpy(&va, a + i, sizeof(va));
+    memcpy(&vb, b + i, sizeof(vb));
+    acc += va * vb;
+  }
+  unsigned int sum = 0;
+  for (int j = 0; j < 8; j++) {
+    sum += acc[j];
+  }
+  for (; i < n; i++) {
+    sum += (unsigned int)a[i] * (unsigned int)b[i];
+  }
+  return sum;
+}
+
+ARRAY_KERNEL
+double kernel_dot_doubles(const double* a, const double* b, long int n) {
+  long int i = 0;
+  simd_doubles acc = { 0 };
+  for (; ARRAY_SIMD && i + 4 <= n; i += 4) {
+    simd_doubles va, vb;
+    memcpy(&va, a + i, sizeof(va));
+    memcpy(&vb, b + i, sizeof(vb));
+    acc += va * vb;
+  }
+  double sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+  for (; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+ARRAY_KERNEL
+void kernel_ints_to_doubles(const int* x, double* out, long int n) {
+  long int i = 0;
+  for (; ARRAY_SIMD && i + 4 <= n; i += 4) {
+    simd_ints4 v;
+    memcpy(&v, x + i, sizeof(v));
+    simd_doubles d = __builtin_convertvector(v, simd_doubles);
+    memcpy(out + i, &d, sizeof(d));
+  }
+  for (; i < n; i++) {
+    out[i] = x[i];
+  }
+}
+
+/**
+ * out[i] = a[i] op b[i]
+ */
+#define KERNEL_MAP(simd, lanes, scalar, op)             \
+  do {                                                  \
+    long int i = 0;                                     \
+    for (; ARRAY_SIMD && i + lanes <= n; i += lanes) {  \
+      simd va, vb;                                      \
+      memcpy(&va, a + i, sizeof(va));                   \
+      memcpy(&vb, b + i, sizeof(vb));                   \
+      va = va op vb;                                    \
+      memcpy(out + i, &va, sizeof(va));                 \
+    }                                                   \
+    for (; i < n; i++) {                                \
+      out[i] = (scalar)a[i] op (scalar)b[i];            \
+    }                                                   \
+  } while (0)
+
+ARRAY_KERNEL
+void kernel_map_ints(char op, const int* a, const int* b, int* out, long int n) {
+  switch (op) {
+  case '+':
+    KERNEL_MAP(simd_uints, 8, unsigned int, +);
+    break;
+  case '-':
+    KERNEL_MAP(simd_uints, 8, unsigned int, -);
+    break;
+  case '*':
+    KERNEL_MAP(simd_uints, 8, unsigned int, *);
+    break;
+  }
+}
+
+ARRAY_KERNEL
+void kernel_map_doubles(char op, const double* a, const double* b, double* out, long int n) {
+  switch (op) {
+  case '+':
+    KERNEL_MAP(simd_doubles, 4, double, +);
+    break;
+  case '-':
+    KERNEL_MAP(simd_doubles, 4, double, -);
+    break;
+  case '*':
+    KERNEL_MAP(simd_doubles, 4, double, *);
+    break;
+  }
+}
+
+#define array_element_size(tag) ((tag) == ints_ot ? sizeof(int) : sizeof(double))
+
+object* array_alloc(enum general_tag tag, int capacity) {
+  object* o = oalloc();
+  array* a = (array*)&oslot(o)->cell;
+  opage(o)->flags[oslot_index(o)] |= SLOT_ARRAY;
+  a->length = 0;
+  a->capacity = capacity > 4 ? capacity : 4;
+  a->data = ostring_alloc(array_element_size(tag) * a->capacity);
+  *o = tag == ints_ot ? make_ints(a) : make_doubles(a);
+  return o;
+}
+
+object* oints(int capacity) {
+  return array_alloc(ints_ot, capacity);
+}
+
+object* odoubles(int capacity) {
+  return array_alloc(doubles_ot, capacity);
+}
+
+/**
+ * A new array with o's elements, in the current allocator.
+ */
+object* array_copy(object* o) {
+  array* a = arrayv(o);
+  object* copy = array_alloc(otag(*o), a->length);
+  memcpy(arrayv(copy)->data, a->data, array_element_size(otag(*o)) * a->length);
+  arrayv(copy)->length = a->length;
+  return copy;
+}
+
+/**
+ * o's elements as doubles. Ints are converted into *scratch, which
+ * the caller frees.
+ */
+const double* array_doubles(object* o, double** scratch) {
+  *scratch = NULL;
+  if (is(*o, doubles)) {
+    return doublesv(o);
+  }
+  *scratch = malloc(sizeof(double) * (arrayv(o)->length + 1));
+  kernel_ints_to_doubles(intsv(o), *scratch, arrayv(o)->length);
+  return *scratch;
+}
+
+object* oarray_from(object* o) {
+  bool doubles = false;
+  if (is(*o, vector)) {
+    for (int i = 0; i < vectorv(o)->length; i++) {
+      if (!is_number(&vectorv(o)->items[i])) {
+        return NIL;
+      }
+      doubles |= is(vectorv(o)->items[i], double);
+    }
+  } else {
+    ofor_each(elm, head, o) {
+      if (!is_number(elm)) {
+        return NIL;
+      }
+      doubles |= is(*elm, double);
+    }
+  }
+
+  object* a = array_alloc(doubles ? doubles_ot : ints_ot, olength(o).value.int_v);
+  if (is(*o, vector)) {
+    for (int i = 0; i < vectorv(o)->length; i++) {
+      oarray_push(a, vectorv(o)->items[i]);
+    }
+  } else {
+    ofor_each(elm, head, o) {
+      oarray_push(a, *elm);
+    }
+  }
+  return a;
+}
+
+object oarray_ref(object* o, int i) {
+  if (i < 0 || i >= arrayv(o)->length) {
+    return *NIL;
+  }
+  return is(*o, ints) ? make_int(intsv(o)[i]) : make_double(doublesv(o)[i]);
+}
+
+object* oarray_set(object* o, int i, object value) {
+  if (i < 0 || i >= arrayv(o)->length || !is_number(&value) ||
+      (is(*o, ints) && !is(value, int))) {
+    return NIL;
+  }
+  if (is(*o, ints)) {
+    intsv(o)[i] = intv(&value);
+  } else {
+    doublesv(o)[i] = numberv(value);
+  }
+  return o;
+}
+
+object* oarray_push(object* o, object value) {
+  array* a = arrayv(o);
+  if (!is_number(&value) || (is(*o, ints) && !is(value, int))) {
+    return NIL;
+  }
+  if (a->length >= a->capacity) {
+    long int size = array_element_size(otag(*o));
+    void* data = ostring_alloc(size * a->capacity * 2);
+    memcpy(data, a->data, size * a->length);
+    buffer_release(a->data);
+    a->data = data;
+    a->capacity *= 2;
+  }
+  a->length++;
+  return oarray_set(o, a->length - 1, value);
+}
+
+object oarray_sum(object* o) {
+  if (is(*o, ints)) {
+    return make_int(kernel_sum_ints(intsv(o), arrayv(o)->length));
+  }
+  return make_double(kernel_sum_doubles(doublesv(o), arrayv(o)->length));
+}
+
+object oarray_min(object* o) {
+  if (!arrayv(o)->length) {
+    return *NIL;
+  } else if (is(*o, ints)) {
+    int min, max;
+    kernel_minmax_ints(intsv(o), arrayv(o)->length, &min, &max);
+    return make_int(min);
+  }
+  double min, max;
+  kernel_minmax_doubles(doublesv(o), arrayv(o)->length, &min, &max);
+  return make_double(min);
+}
+
+object oarray_max(object* o) {
+  if (!arrayv(o)->length) {
+    return *NIL;
+  } else if (is(*o, ints)) {
+    int min, max;
+    kernel_minmax_ints(intsv(o), arrayv(o)->length, &min, &max);
+    return make_int(max);
+  }
+  double min, max;
+  kernel_minmax_doubles(doublesv(o), arrayv(o)->length, &min, &max);
+  return make_double(max);
+}
+
+object oarray_dot(object* a, object* b) {
+  long int n = arrayv(a)->length;
+  if (n != arrayv(b)->length) {
+    return *NIL;
+  } else if (is(*a, ints) && is(*b, ints)) {
+    return make_int(kernel_dot_ints(intsv(a), intsv(b), n));
+  }
+  double* scratch_a;
+  double* scratch_b;
+  double dot = kernel_dot_doubles(array_doubles(a, &scratch_a), array_doubles(b, &scratch_b), n);
+  free(scratch_a);
+  free(scratch_b);
+  return make_double(dot);
+}
+
+/**
+ * a op b elementwise into a new array.
+ */
+object* array_map(char op, object* a, object* b) {
+  long int n = arrayv(a)->length;
+  if (n != arrayv(b)->length) {
+    return NIL;
+  }
+  object* out;
+  if (is(*a, ints) && is(*b, ints)) {
+    out = oints(n);
+    kernel_map_ints(op, intsv(a), intsv(b), intsv(out), n);
+  } else {
+    out = odoubles(n);
+    double* scratch_a;
+    double* scratch_b;
+    const double* da = array_doubles(a, &scratch_a);
+    const double* db = array_doubles(b, &scratch_b);
+    kernel_map_doubles(op, da, db, doublesv(out), n);
+    free(scratch_a);
+    free(scratch_b);
+  }
+  arrayv(out)->length = n;
+  return out;
+}
+
+object* oarray_add(object* a, object* b) {
+  return array_map('+', a, b);
+}
+
+object* oarray_sub(object* a, object* b) {
+  return array_map('-', a, b);
+}
+
+object* oarray_mul(object* a, object* b) {
+  return array_map('*', a, b);
+}
+
+/* **************************************************************
+ * Hash maps
+ * ************************************************************** */
+
+/**
+ * Old table entries looked at by each operation while rehashing.
+ */
+#define HASHMAP_REHASH_STEP 16
+
+uint64_t entry_hash(object* key) {
+  uint64_t h = ohash(key);
+  return h > HASHMAP_DELETED ? h : h + 2;
+}
+
+struct general_table* table_alloc(int capacity) {
+  long int size = sizeof(struct general_table) + sizeof(struct general_entry) * capacity;
+  struct general_table* table = (struct general_table*)ostring_alloc(size);
+  memset(table, 0, size);
+  table->capacity = capacity;
+  return table;
+}
+
+/**
+ * Index of key's entry, -1 if it isn't there. Tables are never full,
+ * so the probe always reaches an empty entry.
+ */
+long int table_find(struct general_table* table, object* key, uint64_t h) {
+  long int mask = table->capacity - 1;
+  for (long int i = h & mask;; i = (i + 1) & mask) {
+    struct general_entry* e = &table->entries[i];
+    if (e->hash == HASHMAP_EMPTY) {
+      return -1;
+    } else if (e->hash == h && is(*oequal(&e->key, key), t)) {
+      return i;
+    }
+  }
+}
+
+/**
+ * Add an entry for a key that isn't in the table.
+ */
+struct general_entry* table_insert(struct general_table* table, object key, uint64_t h) {
+  long int mask = table->capacity - 1;
+  long int i = h & mask;
+  while (table->entries[i].hash > HASHMAP_DELETED) {
+    i = (i + 1) & mask;
+  }
+  struct general_entry* e = &table->entries[i];
+  if (e->hash == HASHMAP_EMPTY) {
+    table->used++;
+  }
+  table->count++;
+  e->key = key;
+  e->hash = h;
+  return e;
+}
+
+/**
+ * Free a key's string, it was copied when the entry was added.
+ */
+void entry_release(struct general_entry* e) {
+  if (is(e->key, string) && ostring_form(&e->key) == STRING_HEAP) {
+    ostring_free(stringv(&e->key));
+  }
+}
+
+void table_release(struct general_table* table) {
+  for (int i = 0; i < table->capacity; i++) {
+    if (table->entries[i].hash > HASHMAP_DELETED) {
+      entry_release(&table->entries[i]);
+    }
+  }
+  buffer_release(table);
+}
+
+void hashmap_release(hashmap* m) {
+  table_release(m->table);
+  if (m->old) {
+    table_release(m->old);
+  }
+}
+
+/**
+ * Move the next few entries of the old table into the new one.
+ */
+void hashmap_step(hashmap* m) {
+  struct general_table* old = m->old;
+  int end = old->cursor + HASHMAP_REHASH_STEP;
+  for (; old->cursor < old->capacity && old->cursor < end; old->cursor++) {
+    struct general_entry* e = &old->entries[old->cursor];
+    if (e->hash > HASHMAP_DELETED) {
+      table_insert(m->table, e->key, e->hash)->value = e->value;
+      e->hash = HASHMAP_DELETED;
+      old->count--;
+    }
+  }
+  if (old->cursor >= old->capacity) {
+    buffer_release(old);
+    m->old = NULL;
+  }
+}
+
+/**
+ * Start moving into a table at most half full. Deleted entries are
+ * dropped, so a table full of them is rebuilt at the same size.
+ */
+void hashmap_grow(hashmap* m) {
+  while (m->old) {
+    hashmap_step(m);
+  }
+  int capacity = m->table->capacity;
+  while (m->table->count * 2 >= capacity) {
+    capacity *= 2;
+  }
+  m->old = m->table;
+  m->table = table_alloc(capacity);
+}
+
+/**
+ * Insert or replace key's value. An owned key is stored as it is,
+ * otherwise a string key is copied.
+ */
+void hashmap_put(object* o, object* key, object value, bool owned) {
+  hashmap* m = hashmapv(o);
+  uint64_t h = entry_hash(key);
+  if (m->old) {
+    hashmap_step(m);
+  }
+  struct general_entry* e = NULL;
+  long int i = table_find(m->table, key, h);
+  if (i >= 0) {
+    e = &m->table->entries[i];
+  } else {
+    object stored = *key;
+    if (m->old && (i = table_find(m->old, key, h)) >= 0) {
+      stored = m->old->entries[i].key;
+      m->old->entries[i].hash = HASHMAP_DELETED;
+      m->old->count--;
+    } else if (!owned && is(stored, string)) {
+      stored = string_copy(key);
+    }
+    if ((m->table->used + 1) * 4 > m->table->capacity * 3) {
+      hashmap_grow(m);
+    }
+    e = table_insert(m->table, stored, h);
+    ogc_barrier(&e->key);
+  }
+  e->value = value;
+  ogc_barrier(&e->value);
+}
+
+object* ohashmap(int capacity) {
+  object* o = oalloc();
+  hashmap* m = (hashmap*)&oslot(o)->cell;
+  opage(o)->flags[oslot_index(o)] |= SLOT_HASHMAP;
+  int size = 8;
+  while (size * 3 < capacity * 4) {
+    size *= 2;
+  }
+  m->table = table_alloc(size);
+  m->old = NULL;
+  *o = make_hashmap(m);
+  return o;
+}
+
+object* ohashmap_get(object* o, object* key) {
+  hashmap* m = hashmapv(o);
+  uint64_t h = entry_hash(key);
+  long int i = table_find(m->table, key, h);
+  if (i >= 0) {
+    return &m->table->entries[i].value;
+  } else if (m->old && (i = table_find(m->old, key, h)) >= 0) {
+    return &m->old->entries[i].value;
+  }
+  return NULL;
+}
+
+object* ohashmap_set(object* o, object key, object value) {
+  hashmap_put(o, &key, value, false);
+  return o;
+}
+
+object* ohashmap_delete(object* o, object* key) {
+  hashmap* m = hashmapv(o);
+  uint64_t h = entry_hash(key);
+  struct general_table* tables[] = { m->table, m->old };
+  for (int k = 0; k < 2 && tables[k]; k++) {
+    long int i = table_find(tables[k], key, h);
+    if (i >= 0) {
+      entry_release(&tables[k]->entries[i]);
+      tables[k]->entries[i].hash = HASHMAP_DELETED;
+      tables[k]->count--;
+      if (m->old) {
+        hashmap_step(m);
+      }
+      return T;
+    }
+  }
+  return NIL;
+}
+
+int ohashmap_count(object* o) {
+  hashmap* m = hashmapv(o);
+  return m->table->count + (m->old ? m->old->count : 0);
+}
+
+bool ohashmap_next(object* o, long int* i, object** key, object** value) {
+  hashmap* m = hashmapv(o);
+  long int end = m->table->capacity + (m->old ? m->old->capacity : 0);
+  for (; *i < end; (*i)++) {
+    struct general_entry* e = *i < m->table->capacity
+      ? &m->table->entries[*i]
+      : &m->old->entries[*i - m->table->capacity];
+    if (e->hash > HASHMAP_DELETED) {
+      *key = &e->key;
+      *value = &e->value;
+      (*i)++;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * New hashmap with the same entries, passed through transform if it
+ * isn't NULL.
+ */
+object* hashmap_copy(object* o, object (*transform)(object*)) {
+  object* copy = ohashmap(ohashmap_count(o));
+  ohashmap_for_each(key, value, o) {
+    if (transform) {
+      object k = transform(key);
+      hashmap_put(copy, &k, transform(value), true);
+    } else {
+      hashmap_put(copy, key, *value, false);
+    }
+  }
+  return copy;
+}
+
+/* **************************************************************
+ * Unrolled lists
+ * ************************************************************** */
+
+/**
+ * Link a new empty block in as the last one, or the first if front.
+ * An empty block starts at the end it grows from.
+ */
+struct general_block* block_add(unrolled* u, bool front) {
+  struct general_block* b =
+    (struct general_block*)ostring_alloc(sizeof(struct general_block));
+  b->start = front ? UNROLLED_BLOCK : 0;
+  b->count = 0;
+  if (u->first) {
+    b->next = u->first;
+    b->prev = u->first->prev;
+    b->prev->next = b;
+    b->next->prev = b;
+  } else {
+    b->next = b;
+    b->prev = b;
+  }
+  if (front || !u->first) {
+    u->first = b;
+  }
+  return b;
+}
+
+/**
+ * Unlink an emptied block.
+ */
+void block_remove(unrolled* u, struct general_block* b) {
+  if (b->next == b) {
+    u->first = NULL;
+  } else {
+    b->prev->next = b->next;
+    b->next->prev = b->prev;
+    if (u->first == b) {
+      u->first = b->next;
+    }
+  }
+  buffer_release(b);
+}
+
+void unrolled_release(unrolled* u) {
+  while (u->first) {
+    block_remove(u, u->first);
+  }
+}
+
+object* ounrolled() {
+  object* o = oalloc();
+  unrolled* u = (unrolled*)&oslot(o)->cell;
+  opage(o)->flags[oslot_index(o)] |= SLOT_UNROLLED;
+  u->first = NULL;
+  u->length = 0;
+  *o = make_unrolled(u);
+  return o;
+}
+
+object* ounrolled_from_list(object* list) {
+  object* o = ounrolled();
+  ofor_each(elm, head, list) {
+    ounrolled_push(o, *elm);
+  }
+  return o;
+}
+
+object* ounrolled_to_list(object* o) {
+  object* list = list_alloc(unrolledv(o)->length);
+  object* node = list;
+  ounrolled_for_each(elm, o) {
+    car(node) = is(*elm, string) ? string_copy(elm) : *elm;
+    node = ocdr(node);
+  }
+  return list;
+}
+
+object* ounrolled_push(object* o, object value) {
+  unrolled* u = unrolledv(o);
+  struct general_block* b = u->first ? u->first->prev : NULL;
+  if (!b || b->start + b->count == UNROLLED_BLOCK) {
+    b = block_add(u, false);
+  }
+  object* item = &b->items[b->start + b->count];
+  *item = value;
+  ogc_barrier(item);
+  b->count++;
+  u->length++;
+  return o;
+}
+
+object* ounrolled_push_front(object* o, object value) {
+  unrolled* u = unrolledv(o);
+  struct general_block* b = u->first;
+  if (!b || b->start == 0) {
+    b = block_add(u, true);
+  }
+  object* item = &b->items[--b->start];
+  *item = value;
+  ogc_barrier(item);
+  b->count++;
+  u->length++;
+  return o;
+}
+
+object ounrolled_pop(object* o) {
+  unrolled* u = unrolledv(o);
+  if (!u->first) {
+    return *NIL;
+  }
+  struct general_block* b = u->first->prev;
+  object value = b->items[b->start + --b->count];
+  if (!b->count) {
+    block_remove(u, b);
+  }
+  u->length--;
+  return value;
+}
+
+object ounrolled_pop_front(object* o) {
+  unrolled* u = unrolledv(o);
+  if (!u->first) {
+    return *NIL;
+  }
+  struct general_block* b = u->first;
+  object value = b->items[b->start++];
+  if (!--b->count) {
+    block_remove(u, b);
+  }
+  u->length--;
+  return value;
+}
+
+object* ounrolled_ref(object* o, long int i) {
+  unrolled* u = unrolledv(o);
+  if (i < 0 || i >= u->length) {
+    return NIL;
+  }
+  struct general_block* b = u->first;
+  if (i < u->length / 2) {
+    while (i >= b->count) {
+      i -= b->count;
+      b = b->next;
+    }
+  } else {
+    /* i counted back from the end of the last block */
+    i = u->length - i;
+    b = b->prev;
+    while (i > b->count) {
+      i -= b->count;
+      b = b->prev;
+    }
+    i = b->count - i;
+  }
+  return &b->items[b->start + i];
+}
+
+object* ounrolled_set(object* o, long int i, object value) {
+  object* item = ounrolled_ref(o, i);
+  if (item == NIL) {
+    return NIL;
+  }
+  *item = value;
+  ogc_barrier(item);
+  return o;
+}
+
+/**
+ * New unrolled list with the same items, passed through transform if
+ * it isn't NULL.
+ */
+object* unrolled_copy(object* o, object (*transform)(object*)) {
+  object* copy = ounrolled();
+  ounrolled_for_each(elm, o) {
+    ounrolled_push(copy, transform ? transform(elm) : *elm);
+  }
+  return copy;
+}
+
+/* **************************************************************
+ * Deques
+ * ************************************************************** */
+
+struct general_ring* ring_alloc(int capacity) {
+  struct general_ring* r = (struct general_ring*)
+    ostring_alloc(sizeof(struct general_ring) + sizeof(object) * capacity);
+  r->capacity = capacity;
+  r->head = 0;
+  r->length = 0;
+  return r;
+}
+
+/**
+ * Move the items to the start of a ring twice the size.
+ */
+void deque_grow(deque* d) {
+  struct general_ring* old = d->ring;
+  struct general_ring* r = ring_alloc(old->capacity * 2);
+  int first = old->capacity - old->head;
+  first = first < old->length ? first : old->length;
+  memcpy(r->items, &old->items[old->head], sizeof(object) * first);
+  memcpy(&r->items[first], old->items, sizeof(object) * (old->length - first));
+  r->length = old->length;
+  d->ring = r;
+  buffer_release(old);
+}
+
+object* odeque(int capacity) {
+  object* o = oalloc();
+  deque* d = (deque*)&oslot(o)->cell;
+  opage(o)->flags[oslot_index(o)] |= SLOT_DEQUE;
+  int size = 4;
+  while (size < capacity) {
+    size *= 2;
+  }
+  d->ring = ring_alloc(size);
+  *o = make_deque(d);
+  return o;
+}
+
+object* odeque_from_list(object* list) {
+  object* o = odeque(olength(list).value.int_v);
+  ofor_each(elm, head, list) {
+    odeque_push(o, *elm);
+  }
+  return o;
+}
+
+object* odeque_to_list(object* o) {
+  object* list = list_alloc(dequev(o)->ring->length);
+  object* node = list;
+  odeque_for_each(elm, o) {
+    car(node) = is(*elm, string) ? string_copy(elm) : *elm;
+    node = ocdr(node);
+  }
+  return list;
+}
+
+object* odeque_push(object* o, object value) {
+  deque* d = dequev(o);
+  if (d->ring->length == d->ring->capacity) {
+    deque_grow(d);
+  }
+  object* item = deque_item(d->ring, d->ring->length);
+  *item = value;
+  ogc_barrier(item);
+  d->ring->length++;
+  return o;
+}
+
+object* odeque_push_front(object* o, object value) {
+  deque* d = dequev(o);
+  if (d->ring->length == d->ring->capacity) {
+    deque_grow(d);
+  }
+  struct general_ring* r = d->ring;
+  r->head = (r->head - 1) & (r->capacity - 1);
+  r->items[r->head] = value;
+  ogc_barrier(&r->items[r->head]);
+  r->length++;
+  return o;
+}
+
+object odeque_pop(object* o) {
+  struct general_ring* r = dequev(o)->ring;
+  if (!r->length) {
+    return *NIL;
+  }
+  r->length--;
+  return *deque_item(r, r->length);
+}
+
+object odeque_pop_front(object* o) {
+  struct general_ring* r = dequev(o)->ring;
+  if (!r->length) {
+    return *NIL;
+  }
+  object value = r->items[r->head];
+  r->head = (r->head + 1) & (r->capacity - 1);
+  r->length--;
+  return value;
+}
+
+object* odeque_ref(object* o, int i) {
+  struct general_ring* r = dequev(o)->ring;
+  if (i < 0 || i >= r->length) {
+    return NIL;
+  }
+  return deque_item(r, i);
+}
+
+object* odeque_set(object* o, int i, object value) {
+  object* item = odeque_ref(o, i);
+  if (item == NIL) {
+    return NIL;
+  }
+  *item = value;
+  ogc_barrier(item);
+  return o;
+}
+
+/**
+ * New deque with the same items, passed through transform if it isn't
+ * NULL.
+ */
+object* deque_copy(object* o, object (*transform)(object*)) {
+  object* copy = odeque(dequev(o)->ring->length);
+  odeque_for_each(elm, o) {
+    odeque_push(copy, transform ? transform(elm) : *elm);
+  }
+  return copy;
+}
+
+/* **************************************************************
+ * Reference counting
+ * ************************************************************** */
+
+/**
+ * Where o's count lives, NULL for the objects that are never counted:
+ * anything but a slot of the global slab.
+ */
+unsigned int* refs_of(object* o) {
+  struct general_page* page = slab_page_of(o);
+  if (!page || page->region) {
+    return NULL;
+  }
+  return &orefs_word(o);
+}
+
+object* oretain(object* o) {
+  unsigned int* refs = refs_of(o);
+  if (!refs) {
+    return o;
+  }
+  unsigned int n = __atomic_load_n(refs, __ATOMIC_RELAXED);
+  if (n & REFS_ATOMIC) {
+    __atomic_add_fetch(refs, 1, __ATOMIC_RELAXED);
+  } else if (n) {
+    *refs = n + 1;
+  } else {
+    *refs = 1;
+    __atomic_add_fetch(&refs_counted, 1, __ATOMIC_RELAXED);
+  }
+  return o;
+}
+
+/**
+ * Free o now its last reference is gone, returns how many slots were
+ * freed.
+ */
+int refs_free(object* o) {
+  orefs_word(o) = 0;
+  __atomic_sub_fetch(&refs_counted, 1, __ATOMIC_RELAXED);
+  return ofree(o);
+}
+
+void orelease(object* o) {
+  unsigned int* refs = refs_of(o);
+  if (!refs) {
+    return;
+  }
+  unsigned int n = __atomic_load_n(refs, __ATOMIC_RELAXED);
+  if (n & REFS_ATOMIC) {
+    if (__atomic_sub_fetch(refs, 1, __ATOMIC_ACQ_REL) != REFS_ATOMIC) {
+      return;
+    }
+  } else if (n != 1) {
+    if (n) {
+      *refs = n - 1;
+    }
+    return;
+  }
+
+  refs_free(o);
+}
+
+object* oatomic(object* o) {
+  unsigned int* refs = refs_of(o);
+  if (refs && !*refs) {
+    oretain(o);
+  }
+  if (refs && *refs) {
+    *refs |= REFS_ATOMIC;
+  }
+  return o;
+}
+
+long int orefs(object* o) {
+  unsigned int* refs = refs_of(o);
+  return refs ? __atomic_load_n(refs, __ATOMIC_RELAXED) & ~REFS_ATOMIC : 0;
+}
+
+int ofree_released() {
+  return heap_reclaim(oheap());
+}
+
+/* **************************************************************
+ * Parallel operations
+ * ************************************************************** */
+
+/**
+ * Run chunks until none are left, with the pool locked. A pool thread
+ * retires its heap after its last chunk, before the job is done.
+ */
+void pool_work(struct general_pool* p, bool worker) {
+  while (p->next < p->chunks) {
+    long int c = p->next++;
+    pthread_mutex_unlock(&p->lock);
+    p->task(p->arg, c);
+    pthread_mutex_lock(&p->lock);
+    if (worker && p->next == p->chunks) {
+      heap_retire();
+    }
+    if (++p->done == p->chunks) {
+      pthread_cond_broadcast(&p->finish);
+    }
+  }
+}
+
+void* pool_worker(void* arg) {
+  struct general_pool* p = arg;
+  pthread_mutex_lock(&p->lock);
+  while (!p->stopping) {
+    pool_work(p, true);
+    pthread_cond_wait(&p->start, &p->lock);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+void opool_start(int n) {
+  if (pool) {
+    return;
+  }
+  if (n <= 0) {
+    n = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  }
+  struct general_pool* p = calloc(1, sizeof(struct general_pool));
+  p->threads = malloc(sizeof(pthread_t) * (n > 0 ? n : 1));
+  pthread_mutex_init(&p->run, NULL);
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->start, NULL);
+  pthread_cond_init(&p->finish, NULL);
+  while (p->size < n && !pthread_create(&p->threads[p->size], NULL, pool_worker, p)) {
+    p->size++;
+  }
+  pool = p;
+}
+
+void opool_stop() {
+  struct general_pool* p = pool;
+  if (!p) {
+    return;
+  }
+  pthread_mutex_lock(&p->run);
+  pool = NULL;
+  pthread_mutex_lock(&p->lock);
+  p->stopping = true;
+  pthread_cond_broadcast(&p->start);
+  pthread_mutex_unlock(&p->lock);
+  for (int i = 0; i < p->size; i++) {
+    pthread_join(p->threads[i], NULL);
+  }
+  pthread_mutex_unlock(&p->run);
+  pthread_mutex_destroy(&p->run);
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->start);
+  pthread_cond_destroy(&p->finish);
+  free(p->threads);
+  free(p);
+}
+
+/**
+ * task(arg, c) for each of the chunks, on the pool if parallel and it
+ * is free, else in order on this thread.
+ */
+void pool_run(void (*task)(void*, long int), void* arg, long int chunks, bool parallel) {
+  struct general_pool* p = pool;
+  if (!parallel || !p || chunks < 2 || pthread_mutex_trylock(&p->run)) {
+    for (long int c = 0; c < chunks; c++) {
+      task(arg, c);
+    }
+    return;
+  }
+  pthread_mutex_lock(&p->lock);
+  p->task = task;
+  p->arg = arg;
+  p->chunks = chunks;
+  p->next = 0;
+  p->done = 0;
+  pthread_cond_broadcast(&p->start);
+  pool_work(p, false);
+  while (p->done < p->chunks) {
+    pthread_cond_wait(&p->finish, &p->lock);
+  }
+  p->chunks = 0;
+  p->next = 0;
+  pthread_mutex_unlock(&p->lock);
+  pthread_mutex_unlock(&p->run);
+}
+
+/**
+ * A list or a vector's items cut into chunks of PARALLEL_CHUNK, and
+ * what an operation keeps per element or chunk.
+ */
+struct parallel_job {
+  object** starts;                 /* each chunk's first cell, NULL for a vector */
+  object* items;                   /* a vector's items */
+  long int length;
+  long int chunks;
+  object (*map)(object*);
+  bool (*keep)(object*);
+  object (*combine)(object, object);
+  object init;
+  object* values;
+  long int* counts;
+  struct general_sum* sums;
+};
+
+/**
+ * Cut o into chunks, walking a list once to find where they start.
+ * Without a pool a list is left whole, as one chunk of unknown length,
+ * unless the length is needed. Anything but a list, headed list or
+ * vector is taken as empty.
+ */
+void parallel_split(struct parallel_job* job, object* o, bool counted) {
+  memset(job, 0, sizeof(struct parallel_job));
+  if (is(*o, headed)) {
+    o = oheaded_list(o);
+  }
+  if (is(*o, vector)) {
+    job->items = vectorv(o)->items;
+    job->length = vectorv(o)->length;
+    job->chunks = (job->length + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+    return;
+  }
+  if (!pool && !counted) {
+    job->starts = malloc(sizeof(object*));
+    job->starts[0] = o;
+    job->length = LONG_MAX;
+    job->chunks = is(*o, cell);
+    return;
+  }
+  long int capacity = 16;
+  job->starts = malloc(sizeof(object*) * capacity);
+  for (; is(*o, cell); o = cdr(o)) {
+    if (job->length % PARALLEL_CHUNK == 0) {
+      if (job->chunks == capacity) {
+        capacity *= 2;
+        job->starts = realloc(job->starts, sizeof(object*) * capacity);
       }
-    if (!is(*cdr(head), nil)) {
-      printf(", ");
+      job->starts[job->chunks++] = o;
     }
+    job->length++;
   }
-  putchar(')');
-  if (!inside) {
-    putchar('\n');
+}
+
+void parallel_run(struct parallel_job* job, void (*task)(void*, long int)) {
+  pool_run(task, job, job->chunks, job->length >= parallel_threshold);
+}
+
+/**
+ * A list, or a vector if the job was cut from one, of the first n
+ * values.
+ */
+object* parallel_result(struct parallel_job* job, long int n) {
+  object* o;
+  if (job->items) {
+    o = ovector(n);
+    for (long int i = 0; i < n; i++) {
+      ovector_push(o, job->values[i]);
+    }
+  } else {
+    o = list_from_objects(job->values, n);
   }
+  free(job->starts);
+  free(job->values);
+  free(job->counts);
+  free(job->sums);
+  return o;
 }
 
-void pl(object* o) {
-  pl_internal(o, false);
+object* chunk_first(struct parallel_job* job, long int c) {
+  return job->items ? job->items + c * PARALLEL_CHUNK : job->starts[c];
+}
+
+long int chunk_end(struct parallel_job* job, long int c) {
+  if (job->length == LONG_MAX) {
+    return LONG_MAX;
+  }
+  long int end = (c + 1) * PARALLEL_CHUNK;
+  return end < job->length ? end : job->length;
+}
+
+/**
+ * Loop over chunk c's elements, i counting them from the start of
+ * the whole.
+ */
+#define ochunk_for_each(elm, i, job, c)                                 \
+  for (object* elm ## _o = chunk_first(job, c); elm ## _o; elm ## _o = NULL) \
+    for (long int i = (c) * PARALLEL_CHUNK, elm ## _end = chunk_end(job, c); \
+         i < elm ## _end && ((job)->items || is(*elm ## _o, cell));  \
+         i++, elm ## _o = (job)->items ? elm ## _o + 1 : cdr(elm ## _o)) \
+      for (object* elm = (job)->items ? elm ## _o : &car(elm ## _o); elm; elm = NULL)
+
+void map_chunk(void* arg, long int c) {
+  struct parallel_job* job = arg;
+  ochunk_for_each(elm, i, job, c) {
+    job->values[i] = job->map(elm);
+  }
+}
+
+object* omap(object* o, object (*fn)(object*)) {
+  struct parallel_job job;
+  parallel_split(&job, o, true);
+  job.map = fn;
+  job.values = malloc(sizeof(object) * job.length);
+  __atomic_add_fetch(&gc_held, 1, __ATOMIC_RELAXED);
+  parallel_run(&job, map_chunk);
+  object* result = parallel_result(&job, job.length);
+  __atomic_sub_fetch(&gc_held, 1, __ATOMIC_RELAXED);
+  return result;
+}
+
+/**
+ * Moves the elements a chunk keeps to the front of its part of values.
+ */
+void filter_chunk(void* arg, long int c) {
+  struct parallel_job* job = arg;
+  long int kept = c * PARALLEL_CHUNK;
+  ochunk_for_each(elm, i, job, c) {
+    if (job->keep(elm)) {
+      job->values[kept++] = *elm;
+    }
+  }
+  job->counts[c] = kept - c * PARALLEL_CHUNK;
+}
+
+object* ofilter(object* o, bool (*pred)(object*)) {
+  struct parallel_job job;
+  parallel_split(&job, o, true);
+  job.keep = pred;
+  job.values = malloc(sizeof(object) * job.length);
+  job.counts = malloc(sizeof(long int) * job.chunks);
+  __atomic_add_fetch(&gc_held, 1, __ATOMIC_RELAXED);
+  parallel_run(&job, filter_chunk);
+  long int n = 0;
+  for (long int c = 0; c < job.chunks; c++) {
+    memmove(&job.values[n], &job.values[c * PARALLEL_CHUNK], sizeof(object) * job.counts[c]);
+    n += job.counts[c];
+  }
+  object* result = parallel_result(&job, n);
+  __atomic_sub_fetch(&gc_held, 1, __ATOMIC_RELAXED);
+  return result;
+}
+
+void reduce_chunk(void* arg, long int c) {
+  struct parallel_job* job = arg;
+  object value = job->init;
+  ochunk_for_each(elm, i, job, c) {
+    value = job->combine(value, *elm);
+  }
+  job->values[c] = value;
+}
+
+object oreduce(object* o, object (*fn)(object, object), object init) {
+  struct parallel_job job;
+  parallel_split(&job, o, false);
+  job.combine = fn;
+  job.init = init;
+  job.values = malloc(sizeof(object) * job.chunks);
+  __atomic_add_fetch(&gc_held, 1, __ATOMIC_RELAXED);
+  parallel_run(&job, reduce_chunk);
+  object value = init;
+  for (long int c = 0; c < job.chunks; c++) {
+    value = fn(value, job.values[c]);
+  }
+  __atomic_sub_fetch(&gc_held, 1, __ATOMIC_RELAXED);
+  free(job.starts);
+  free(job.values);
+  return value;
+}
+
+void add_chunk(void* arg, long int c) {
+  struct parallel_job* job = arg;
+  struct general_sum sum = { 0, 0, true };
+  ochunk_for_each(elm, i, job, c) {
+    sum_add(&sum, elm, 1);
+  }
+  job->sums[c] = sum;
+}
+
+object oadd_parallel(object* o) {
+  object* list = is(*o, headed) ? oheaded_list(o) : o;
+  if (!is(*list, cell) && !is(*list, vector)) {
+    return oadd(o);
+  }
+  struct parallel_job job;
+  parallel_split(&job, list, false);
+  job.sums = malloc(sizeof(struct general_sum) * job.chunks);
+  parallel_run(&job, add_chunk);
+  struct general_sum sum = { 0, 0, true };
+  for (long int c = 0; c < job.chunks; c++) {
+    sum.iout += job.sums[c].iout;
+    sum.dout += job.sums[c].dout;
+    sum.is_int = sum.is_int && job.sums[c].is_int;
+  }
+  free(job.starts);
+  free(job.sums);
+  return sum_value(&sum);
+}
+
+/**
+ * A subtree for a steal_job, or two for oequal_parallel().
+ */
+struct steal_task {
+  object a;
+  object b;
+};
+
+/**
+ * Each thread's queue of subtrees. The owner pushes and pops at the
+ * bottom; a thread that runs out takes from the top of another's,
+ * where the oldest and usually largest subtrees are.
+ */
+struct steal_queue {
+  pthread_mutex_t lock;
+  struct steal_task* items;
+  long int top;
+  long int bottom;
+  long int length;
+};
+
+struct steal_job {
+  struct steal_queue* queues;
+  int count;
+  long int pending;                /* tasks pushed and not yet run */
+  void (*run)(struct steal_job*, int, struct steal_task);
+  void* arg;
+};
+
+void steal_push(struct steal_job* job, int w, struct steal_task task) {
+  struct steal_queue* q = &job->queues[w];
+  __atomic_add_fetch(&job->pending, 1, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&q->lock);
+  q->items = array_room(q->items, q->bottom, &q->length, sizeof(struct steal_task));
+  q->items[q->bottom++] = task;
+  pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * Take a task from queue w's bottom, or its top if stealing.
+ */
+bool steal_take(struct steal_job* job, int w, bool stealing, struct steal_task* task) {
+  struct steal_queue* q = &job->queues[w];
+  bool found = false;
+  pthread_mutex_lock(&q->lock);
+  if (q->bottom > q->top) {
+    *task = stealing ? q->items[q->top++] : q->items[--q->bottom];
+    found = true;
+  }
+  if (q->bottom == q->top) {
+    q->bottom = q->top = 0;
+  }
+  pthread_mutex_unlock(&q->lock);
+  return found;
+}
+
+/**
+ * Run tasks as thread w until every queue is empty and no task is left
+ * running that could push more.
+ */
+void steal_worker(void* arg, long int w) {
+  struct steal_job* job = arg;
+  struct steal_task task;
+  while (true) {
+    bool found = steal_take(job, w, false, &task);
+    for (int i = 1; !found && i < job->count; i++) {
+      found = steal_take(job, (w + i) % job->count, true, &task);
+    }
+    if (found) {
+      job->run(job, w, task);
+      __atomic_sub_fetch(&job->pending, 1, __ATOMIC_ACQ_REL);
+    } else if (!__atomic_load_n(&job->pending, __ATOMIC_ACQUIRE)) {
+      return;
+    } else {
+      sched_yield();
+    }
+  }
+}
+
+/**
+ * Run job from first on count threads, the pool's and this one.
+ */
+void steal_run(struct steal_job* job, int count, struct steal_task first) {
+  job->count = count;
+  job->pending = 0;
+  job->queues = calloc(count, sizeof(struct steal_queue));
+  for (int w = 0; w < count; w++) {
+    pthread_mutex_init(&job->queues[w].lock, NULL);
+  }
+  steal_push(job, 0, first);
+  pool_run(steal_worker, job, count, true);
+  for (int w = 0; w < count; w++) {
+    pthread_mutex_destroy(&job->queues[w].lock);
+    free(job->queues[w].items);
+  }
+  free(job->queues);
+}
+
+#define COPY_BLOCK 65536
+#define COPY_RANGE 256
+#define COPY_LOCKS 4096
+
+/**
+ * A thread's share of ocopy_deep_parallel(): the numbers it has left
+ * to hand out, and the cells whose strings and tails are copied at
+ * the end.
+ */
+struct copy_worker {
+  long int next;
+  long int end;
+  long int tails;
+  long int* special;
+  long int specials;
+  long int length;
+};
+
+/**
+ * Like ocopy_deep() reached cells are numbered in a side table, split
+ * here into COPY_LOCKS stripes by address, each changed only under its
+ * lock. Numbers are handed out COPY_RANGE at a time, so some go unused.
+ */
+struct copy_job {
+  object** blocks;   /* reached cells by number, COPY_BLOCK to a block */
+  long int reserved; /* numbers handed out */
+  struct copy_worker* workers;
+  object** copies;
+  struct general_ptrmap numbers[COPY_LOCKS];
+  unsigned char locks[COPY_LOCKS];
+};
+
+object* copy_node(struct copy_job* job, long int i) {
+  object* block = __atomic_load_n(&job->blocks[i / COPY_BLOCK], __ATOMIC_ACQUIRE);
+  return block ? &block[i % COPY_BLOCK] : NULL;
+}
+
+long int copy_stripe(cell* c) {
+  return ((uintptr_t)c >> 4) % COPY_LOCKS;
+}
+
+/**
+ * c's number, -1 if it hasn't been reached. While the cells are being
+ * numbered only call it holding c's stripe lock.
+ */
+long int copy_index(struct copy_job* job, cell* c) {
+  return ptrmap_find(&job->numbers[copy_stripe(c)], c);
+}
+
+long int copy_number(struct copy_job* job, int w) {
+  struct copy_worker* cw = &job->workers[w];
+  if (cw->next == cw->end) {
+    cw->next = __atomic_fetch_add(&job->reserved, COPY_RANGE, __ATOMIC_RELAXED);
+    cw->end = cw->next + COPY_RANGE;
+  }
+  long int i = cw->next++;
+  object** slot = &job->blocks[i / COPY_BLOCK];
+  if (!__atomic_load_n(slot, __ATOMIC_ACQUIRE)) {
+    object* block = calloc(COPY_BLOCK, sizeof(object));
+    object* expected = NULL;
+    if (!__atomic_compare_exchange_n(slot, &expected, block, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      free(block);
+    }
+  }
+  return i;
+}
+
+/**
+ * Number the cells along task.a's cdrs, stopping at one already
+ * reached, and queue the lists in their cars.
+ */
+void copy_task(struct steal_job* steal, int w, struct steal_task task) {
+  struct copy_job* job = steal->arg;
+  struct copy_worker* cw = &job->workers[w];
+  object ref = task.a;
+  while (true) {
+    cell* c = cellv(&ref);
+    long int stripe = copy_stripe(c);
+    unsigned char* lock = &job->locks[stripe];
+    while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE)) {
+      sched_yield();
+    }
+    if (copy_index(job, c) >= 0) {
+      __atomic_clear(lock, __ATOMIC_RELEASE);
+      return;
+    }
+    long int i = copy_number(job, w);
+    ptrmap_add(&job->numbers[stripe], c, i);
+    __atomic_clear(lock, __ATOMIC_RELEASE);
+    *copy_node(job, i) = ref;
+
+    object* x = &c->car;
+    if (is(*x, cell)) {
+      steal_push(steal, w, (struct steal_task){ *x, *x });
+    }
+    object* next = cell_next(&ref);
+    if (is(*x, string) || deep_tail(next)) {
+      cw->special = array_room(cw->special, cw->specials, &cw->length, sizeof(long int));
+      cw->special[cw->specials++] = i;
+      cw->tails += deep_tail(next);
+    }
+    if (!is(*next, cell)) {
+      return;
+    }
+    ref = *next;
+  }
+}
+
+/**
+ * Fill in the copies numbered in chunk c, all but their strings and
+ * tails.
+ */
+void copy_fill_chunk(void* arg, long int c) {
+  struct copy_job* job = arg;
+  long int end = (c + 1) * PARALLEL_CHUNK;
+  end = end < job->reserved ? end : job->reserved;
+  for (long int i = c * PARALLEL_CHUNK; i < end; i++) {
+    if (!job->copies[i]) {
+      continue;
+    }
+    object* node = copy_node(job, i);
+    cell* cc = &oslot(job->copies[i])->cell;
+    *job->copies[i] = make_cell(cc);
+    object* x = &cellv(node)->car;
+    if (is(*x, cell)) {
+      cc->car = make_cell(&oslot(job->copies[copy_index(job, cellv(x))])->cell);
+    } else {
+      cc->car = *x;
+    }
+    object* next = cell_next(node);
+    if (is(*next, cell)) {
+      cc->cdr = job->copies[copy_index(job, cellv(next))];
+    } else {
+      cc->cdr = deep_tail(next) ? NULL : next;
+    }
+  }
+}
+
+object* ocopy_deep_parallel(object* o) {
+  if (!pool || !is(*o, cell)) {
+    return ocopy_deep(o);
+  }
+  /* the copies are allocated without checking, so the collector has its turn now */
+  if (!current_region) {
+    oalloc_reserve(0);
+  }
+  int count = pool->size + 1;
+  struct copy_job* job = calloc(1, sizeof(struct copy_job));
+  job->blocks = calloc(INT_MAX / COPY_BLOCK + 1, sizeof(object*));
+  job->workers = calloc(count, sizeof(struct copy_worker));
+  struct steal_job steal = { .run = copy_task, .arg = job };
+  steal_run(&steal, count, (struct steal_task){ *o, *o });
+
+  long int tails = 0, unused = 0;
+  for (int w = 0; w < count; w++) {
+    tails += job->workers[w].tails;
+    unused += job->workers[w].end - job->workers[w].next;
+  }
+  long int n = job->reserved - unused + tails;
+  job->copies = malloc(sizeof(object*) * job->reserved);
+  if (!current_region) {
+    gc_allocated += n;
+    registry_reserve(n);
+  }
+  for (long int i = 0; i < job->reserved; i++) {
+    object* node = copy_node(job, i);
+    job->copies[i] = node && is(*node, cell) ?
+      oalloc_init(current_region ? region_alloc(current_region) : slab_alloc()) : NULL;
+  }
+  long int chunks = (job->reserved + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+  pool_run(copy_fill_chunk, job, chunks, true);
+  object* copy = job->copies[copy_index(job, cellv(o))];
+
+  /* strings and tails, which allocate, on this thread */
+  for (int w = 0; w < count; w++) {
+    struct copy_worker* cw = &job->workers[w];
+    for (long int k = 0; k < cw->specials; k++) {
+      object* node = copy_node(job, cw->special[k]);
+      cell* cc = &oslot(job->copies[cw->special[k]])->cell;
+      if (is(cellv(node)->car, string)) {
+        cc->car = string_copy(&cellv(node)->car);
+      }
+      object* next = cell_next(node);
+      if (deep_tail(next)) {
+        cc->cdr = oalloc_init(current_region ? region_alloc(current_region) : slab_alloc());
+        *cc->cdr = is(*next, string) ? string_copy(next) : *next;
+      }
+    }
+    free(cw->special);
+  }
+  for (long int b = 0; b * COPY_BLOCK < job->reserved; b++) {
+    free(job->blocks[b]);
+  }
+  for (long int k = 0; k < COPY_LOCKS; k++) {
+    ptrmap_free(&job->numbers[k]);
+  }
+  free(job->blocks);
+  free(job->workers);
+  free(job->copies);
+  free(job);
+  return copy;
+}
+
+/**
+ * Compare task.a and task.b along their cdrs, queueing the pairs of
+ * lists in their cars.
+ */
+void equal_task(struct steal_job* steal, int w, struct steal_task task) {
+  bool* equal = steal->arg;
+  object* a = &task.a;
+  object* b = &task.b;
+  while (is(*a, cell) && is(*b, cell)) {
+    if (!__atomic_load_n(equal, __ATOMIC_RELAXED)) {
+      return;
+    }
+    object* x = &car(a);
+    object* y = &car(b);
+    if (is(*x, cell) && is(*y, cell)) {
+      steal_push(steal, w, (struct steal_task){ *x, *y });
+    } else if (!is(*oequal(x, y), t)) {
+      __atomic_store_n(equal, false, __ATOMIC_RELAXED);
+      return;
+    }
+    a = cell_next(a);
+    b = cell_next(b);
+  }
+  if (!is(*oequal(a, b), t)) {
+    __atomic_store_n(equal, false, __ATOMIC_RELAXED);
+  }
+}
+
+object* oequal_parallel(object* a, object* b) {
+  if (!pool || !is(*a, cell) || !is(*b, cell)) {
+    return oequal(a, b);
+  }
+  bool equal = true;
+  struct steal_job steal = { .run = equal_task, .arg = &equal };
+  steal_run(&steal, pool->size + 1, (struct steal_task){ *a, *b });
+  return booly(equal);
 }
 
 /* general.c ends here */
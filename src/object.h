@@ -2,6 +2,8 @@
 #define OBJECT_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 
 /**
  * Type Specifiers
@@ -14,7 +16,15 @@ enum general_tag {
   nil_ot = 4,
   t_ot = 5,
   cell_ot = 6,
-  error_ot = 7
+  error_ot = 7,
+  vector_ot = 8,
+  ints_ot = 9,
+  doubles_ot = 10,
+  symbol_ot = 11,
+  hashmap_ot = 12,
+  unrolled_ot = 13,
+  headed_ot = 14,
+  deque_ot = 15
 };
 
 /**
@@ -39,6 +49,22 @@ const char* tag_string(enum general_tag t) {
       return "t";
     case cell_ot:
       return "cell";
+    case vector_ot:
+      return "vector";
+    case ints_ot:
+      return "ints";
+    case doubles_ot:
+      return "doubles";
+    case symbol_ot:
+      return "symbol";
+    case hashmap_ot:
+      return "hashmap";
+    case unrolled_ot:
+      return "unrolled";
+    case headed_ot:
+      return "headed";
+    case deque_ot:
+      return "deque";
     }
   return "unknown";
 }
@@ -57,32 +83,168 @@ typedef char byte;
 struct general_cell;
 typedef struct general_cell cell;
 
+/**
+ * Vector struct
+ */
+struct general_vector;
+typedef struct general_vector vector;
+
+/**
+ * Numeric array struct
+ */
+struct general_array;
+typedef struct general_array array;
+
+/**
+ * Hash table struct
+ */
+struct general_hashmap;
+typedef struct general_hashmap hashmap;
+
+/**
+ * Unrolled list struct
+ */
+struct general_unrolled;
+typedef struct general_unrolled unrolled;
+
+/**
+ * List builder struct, also the header of a headed list
+ */
+struct general_builder;
+
+/**
+ * Deque struct
+ */
+struct general_deque;
+typedef struct general_deque deque;
+
 /**
  * Object struct
  */
 struct general_object;
 typedef struct general_object object;
 
+/**
+ * How a string object holds its characters.
+ */
+enum general_string_form {
+  STRING_RAW = 0,   /* any char*, from setstringv() */
+  STRING_HEAP = 1,  /* from ostring_new(), length prefixed */
+  STRING_SMALL = 2  /* inline in the object, no allocation */
+};
+
+/**
+ * Header in front of the characters of a STRING_HEAP string.
+ */
+struct general_string {
+  uint32_t length;
+  uint32_t hash; /* 0 until ostring_hash() */
+  char bytes[];
+};
+
+#define ostring_header(s) ((struct general_string*)((char*)(s) - sizeof(struct general_string)))
+
+#ifdef GENERAL_NANBOX
+
+/**
+ * Compiled with GENERAL_NANBOX an object is a single 64 bit word. A
+ * double is stored as itself. Anything else is a NaN that can't come
+ * out of arithmetic: sign and exponent bits all set, a 4 bit tag and
+ * a 48 bit payload holding the int, byte or pointer.
+ */
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "GENERAL_NANBOX needs a little endian target"
+#endif
+
+/**
+ * object value union, int_v, byte_v and small overlay the low payload
+ * bits
+ */
+union general_values {
+  uint64_t bits;
+  double double_v;
+  int int_v;
+  byte byte_v;
+  char small[8];
+};
+
+/**
+ * Object definition
+ */
+struct general_object {
+  union general_values value;
+};
+
+#define NANBOX_PAYLOAD 0x0000FFFFFFFFFFFFull
+
+/**
+ * tag -> the 4 bits above the payload. 0 would be -infinity and 8 is
+ * the NaN the hardware makes, so they are skipped. Once the nibbles
+ * with the sign set run out, tags go on after the strings' nibbles
+ * with the sign clear, from 3.
+ */
+#define nanbox_nibble(t) ((t) == int_ot ? 1 : (t) < 8 ? (t) : (t) < 15 ? (t) + 1 : (t) - 12)
+#define nanbox_box(t)                                                   \
+  (((t) < 15 ? 0xFFF0000000000000ull : 0x7FF0000000000000ull) |        \
+   ((uint64_t)nanbox_nibble(t) << 48))
+
+/**
+ * Small and raw strings are boxed in NaNs with the sign bit clear,
+ * the rest of the strings are heap strings.
+ */
+#define NANBOX_SMALL_STRING 0x7FF1000000000000ull
+#define NANBOX_RAW_STRING   0x7FF2000000000000ull
+
+/**
+ * the sign and 4 bits above the payload -> tag
+ */
+const signed char nanbox_tags[32] = {
+  -1, int_ot, string_ot, byte_ot, nil_ot, t_ot, cell_ot, error_ot,
+  -1, vector_ot, ints_ot, doubles_ot, symbol_ot, hashmap_ot, unrolled_ot, headed_ot,
+  -1, string_ot, string_ot, deque_ot, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+enum general_tag nanbox_tag(uint64_t bits) {
+  int i = ((bits >> 48) & 0xF) | (int)((~bits >> 59) & 0x10);
+  if (((bits >> 52) & 0x7FF) != 0x7FF || nanbox_tags[i] < 0) {
+    return double_ot;
+  }
+  return nanbox_tags[i];
+}
+
+#else
+
 /**
  * object value union
  */
 union general_values {
   int int_v;
   double double_v;
-  string string_v; /* also the error */
+  string string_v; /* also the error and symbol */
   byte byte_v;
   cell* cell_v;
+  vector* vector_v;
+  array* array_v;
+  hashmap* hashmap_v;
+  unrolled* unrolled_v;
+  struct general_builder* headed_v;
+  deque* deque_v;
+  char small[8];
 };
 
 
 /**
- * Object definition
+ * Object definition, form is only used by strings.
  */
 struct general_object {
   enum general_tag tag;
+  enum general_string_form form;
   union general_values value;
 };
 
+#endif
+
 
 /**
  * Cell definition
@@ -92,12 +254,379 @@ struct general_cell {
   object* cdr;
 };
 
+/**
+ * A cdr coded list is packed into runs, each cell is its header and
+ * car with no cdr. The cdr of a coded cell is the next header in the
+ * run. The last cell of a run is an ordinary cell, the run's tail
+ * pointer after its car is its cdr.
+ */
+struct general_packed {
+  object obj;
+  object car;
+};
+
+struct general_run {
+  int size;   /* bytes, a power of two and the run's alignment */
+  int length;
+  struct general_packed cells[];
+};
+
+/**
+ * Vector definition, items is one contiguous array.
+ */
+struct general_vector {
+  object* items;
+  int length;
+  int capacity;
+};
+
+/**
+ * Numeric array definition, unboxed ints (ints_ot) or doubles
+ * (doubles_ot) in one contiguous block.
+ */
+struct general_array {
+  void* data;
+  int length;
+  int capacity;
+};
+
+/**
+ * Hash table entry, hash is HASHMAP_EMPTY, HASHMAP_DELETED or the
+ * key's ohash() moved out of their way.
+ */
+struct general_entry {
+  object key;
+  object value;
+  uint64_t hash;
+};
+
+#define HASHMAP_EMPTY   0
+#define HASHMAP_DELETED 1
+
+/**
+ * Open addressed, linearly probed entries. used counts deleted
+ * entries too, they still lengthen probes.
+ */
+struct general_table {
+  int capacity; /* a power of two */
+  int count;
+  int used;
+  int cursor;   /* next entry to move, while this is the old table */
+  struct general_entry entries[];
+};
+
+/**
+ * Hash table definition. After a resize the old table is kept and a
+ * few of its entries are moved by each operation until it is empty.
+ */
+struct general_hashmap {
+  struct general_table* table;
+  struct general_table* old; /* NULL unless rehashing */
+};
+
+/**
+ * Objects per block of an unrolled list.
+ */
+#define UNROLLED_BLOCK 16
+
+/**
+ * A block holds count items from items[start], the blocks form a
+ * ring so the last one is first->prev.
+ */
+struct general_block {
+  struct general_block* next;
+  struct general_block* prev;
+  int start;
+  int count;
+  object items[UNROLLED_BLOCK];
+};
+
+/**
+ * Unrolled list definition
+ */
+struct general_unrolled {
+  struct general_block* first; /* NULL while empty */
+  long int length;
+};
+
+/**
+ * A deque's items, length of them from items[head] on, wrapping
+ * around. capacity is a power of two.
+ */
+struct general_ring {
+  int capacity;
+  int head;
+  int length;
+  object items[];
+};
+
+/**
+ * Deque definition
+ */
+struct general_deque {
+  struct general_ring* ring;
+};
+
+
+/* **************************************************************
+ * Slab allocation
+ * ************************************************************** */
+
+/**
+ * A slot is an object header with room for the cell it points to.
+ * cons() fills both halves, so a list node is one allocation. A
+ * vector keeps its length and items pointer in the cell half.
+ */
+struct general_slot {
+  object obj;
+  cell cell;
+};
+
+_Static_assert(sizeof(vector) <= sizeof(cell), "a vector must fit in a slot");
+_Static_assert(sizeof(array) <= sizeof(cell), "an array must fit in a slot");
+_Static_assert(sizeof(hashmap) <= sizeof(cell), "a hashmap must fit in a slot");
+_Static_assert(sizeof(unrolled) <= sizeof(cell), "an unrolled list must fit in a slot");
+_Static_assert(sizeof(deque) <= sizeof(cell), "a deque must fit in a slot");
+
+/**
+ * Slots are bump allocated out of large pages. Pages are aligned to
+ * their size so any slot can find the page it lives in.
+ */
+#define SLAB_PAGE_SIZE (64 * 1024)
+
+struct general_region;
+struct general_heap;
+
+/**
+ * Each slot has a flags byte, its index in allocated_objects and its
+ * reference count, kept in the page header next to the slots.
+ */
+#define SLAB_PAGE_SLOTS                                                 \
+  ((SLAB_PAGE_SIZE - 64) / (sizeof(struct general_slot) + 2 * sizeof(unsigned int) + 1))
+
+struct general_page {
+  struct general_page* next;
+  struct general_region* region; /* NULL for the global slab */
+  struct general_heap* heap;     /* whose registry its slots are in */
+  unsigned long int used;
+  unsigned char flags[SLAB_PAGE_SLOTS];
+  unsigned int index[SLAB_PAGE_SLOTS];
+  unsigned int refs[SLAB_PAGE_SLOTS]; /* 0 while it isn't counted */
+  struct general_slot slots[];
+};
+
+/**
+ * Slot flags
+ */
+#define SLOT_MARK_OBJ  0x01 /* the header was reached */
+#define SLOT_MARK_CELL 0x02 /* the cell (or vector) was reached */
+#define SLOT_MARKS     (SLOT_MARK_OBJ | SLOT_MARK_CELL)
+#define SLOT_LIVE      0x04 /* in allocated_objects */
+#define SLOT_VECTOR    0x08 /* the cell half holds a vector */
+#define SLOT_ARRAY     0x10 /* the cell half holds a numeric array */
+#define SLOT_HASHMAP   0x20 /* the cell half holds a hashmap */
+#define SLOT_UNROLLED  0x40 /* the cell half holds an unrolled list */
+#define SLOT_DEQUE     0x80 /* the cell half holds a deque */
+
+/**
+ * slot <- header
+ */
+#define oslot(o) ((struct general_slot*)(o))
+
+/**
+ * page <- slot or header
+ */
+#define opage(o) ((struct general_page*)((uintptr_t)(o) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1)))
+
+/**
+ * index of the slot o points into, in its page
+ */
+#define oslot_index(o)                                                  \
+  ((long int)(((char*)(o) - (char*)opage(o)->slots) / sizeof(struct general_slot)))
+
+
+
+/* **************************************************************
+ * Regions
+ * ************************************************************** */
+
+/**
+ * Strings made inside a region are bump allocated from chunks.
+ */
+#define REGION_CHUNK_SIZE (64 * 1024)
+
+struct general_chunk {
+  struct general_chunk* next;
+  long int size;
+  long int used;
+  char bytes[];
+};
+
+/**
+ * While a region is open every oalloc(), cell and string comes out of
+ * its pages and chunks, and oregion_end() gives them all back at once.
+ * Regions nest.
+ */
+struct general_region {
+  struct general_region* parent;
+  struct general_page* pages;
+  struct general_chunk* chunks;
+};
+
+__thread struct general_region* current_region = NULL;
+
+/* **************************************************************
+ * Pointer sets
+ * ************************************************************** */
+
+/**
+ * Open addressed set of pointers, with a mark byte per entry.
+ */
+struct general_ptrset {
+  void** keys;
+  unsigned char* marks;
+  long int size; /* a power of two */
+  long int count;
+};
+
+/**
+ * Open addressed map from pointers to numbers.
+ */
+struct general_ptrmap {
+  void** keys;
+  long int* values;
+  long int size; /* a power of two */
+  long int count;
+};
+
+/**
+ * Every slab page, global or region, as a bit per page in leaves of
+ * 2^SLAB_MAP_BITS pages, so looking one up takes no lock. Leaves are
+ * made under heap_lock and kept. The map covers 48 bits of address;
+ * pages above that go in slab_page_set, under heap_lock.
+ */
+#define SLAB_MAP_BITS 16
+
+unsigned long int* slab_page_map[1 << SLAB_MAP_BITS];
+
+struct general_ptrset slab_page_set = { 0 };
+
+/* **************************************************************
+ * Heaps
+ * ************************************************************** */
+
+/**
+ * Each thread allocates from its own heap: its pages, free slots,
+ * registry of live objects and owned strings, none of which take a
+ * lock. Slots freed by other threads are pushed on remote and taken
+ * back by the owner. When a thread exits its heap is abandoned, with
+ * everything in it, and the next thread to start adopts it.
+ */
+struct general_heap {
+  struct general_page* pages;      /* fresh slots are carved from the first */
+  struct general_slot* free_slots;
+  struct general_slot* remote;     /* freed elsewhere, linked by cell.cdr */
+  object** objects;
+  long int count;
+  long int length;
+  long int sweep;                  /* objects below this aren't swept yet */
+  struct general_ptrset strings;
+  unsigned long int epoch;         /* stack_epoch while in opop_atomic(), else 0 */
+  struct general_limbo {
+    object** cells;                /* unlinked in epoch, not yet freed */
+    long int count;
+    long int length;
+    unsigned long int epoch;
+  } limbo[3];
+  bool abandoned;
+  struct general_heap* next;
+};
+
+/**
+ * Cells opop_atomic() unlinks are freed once every thread has moved
+ * past the epoch they were unlinked in, which it can only do outside
+ * opop_atomic(): one that went in earlier may still be reading them.
+ */
+unsigned long int stack_epoch = 1;
+
+/**
+ * Every heap, newest first, and how many have a thread.
+ */
+struct general_heap* heaps = NULL;
+long int heaps_active = 0;
+
+__thread struct general_heap* local_heap = NULL;
+
+/**
+ * Guards what threads share: the page set, heaps, roots and interned
+ * strings.
+ */
+pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The calling thread's heap, made or adopted on first use.
+ */
+struct general_heap* oheap(void);
+
+/**
+ * Give up the calling thread's heap for another to adopt, like exiting
+ * does. Allocating again adopts one.
+ */
+void heap_retire(void);
+
+/**
+ * Every string ostring_alloc() handed out from this thread's heap.
+ */
+#define owned_strings (oheap()->strings)
+
+/* **************************************************************
+ * Interning
+ * ************************************************************** */
+
+/**
+ * Set of interned strings. Each is stored once, never changes and is
+ * never freed, so two interned strings are equal when their pointers
+ * are.
+ */
+struct general_intern_table {
+  string* keys;
+  uint64_t* hashes;
+  long int size; /* a power of two */
+  long int count;
+  struct general_chunk* chunks;
+};
+
+struct general_intern_table intern_table = { 0 };
+
+/**
+ * With this set make_string() interns its string and makes a symbol.
+ */
+bool intern_strings = false;
+
+/**
+ * Scoped region, ended when the body finishes (don't break out of it).
+ * example: oregion(r) { ... }
+ */
+#define oregion(name)                                   \
+  for(struct general_region* name = oregion_begin();    \
+      name != NULL;                                     \
+      oregion_end(name), name = NULL)
+
+
+/**
+ * The tag of an object.
+ */
+#ifdef GENERAL_NANBOX
+#define otag(o) (nanbox_tag((o).value.bits))
+#else
+#define otag(o) ((o).tag)
+#endif
 
 /**
  * is(object, type)??
  * example: is(var, cell)
  */
-#define is(o, type) ((o).tag == type ## _ot)
+#define is(o, type) (otag(o) == type ## _ot)
 
 /**
  * Is the object nil?
@@ -145,7 +674,7 @@ void pl(object*);
  * Because lisp
  * ************************************************************** */
 #define car(o)     (cellv(o)->car)
-#define cdr(o)     (cellv(o)->cdr)
+#define cdr(o)     (ocdr(o))
 #define cadr(o)    (car(cdr(o)))
 #define caddr(o)   (car(cdr(cdr(o))))
 #define cadddr(o)  (car(cdr(cdr(cdr(o)))))
@@ -173,6 +702,15 @@ void pl(object*);
 /* **************************************************************
  * nil and t globals for use in C
  * ************************************************************** */
+#ifdef GENERAL_NANBOX
+const object nil_global = {
+  .value.bits = nanbox_box(nil_ot)
+};
+
+const object t_global = {
+  .value.bits = nanbox_box(t_ot)
+};
+#else
 const object nil_global = {
   .tag = nil_ot
 };
@@ -180,6 +718,7 @@ const object nil_global = {
 const object t_global = {
   .tag = t_ot
 };
+#endif
 
 #define NIL ((object*)&nil_global)
 #define T ((object*)&t_global)
@@ -187,13 +726,117 @@ const object t_global = {
 /* **************************************************************
  * Value macros
  * ************************************************************** */
-#define cellv(o)   ((o)->value.cell_v)
 #define intv(o)    ((o)->value.int_v)
 #define doublev(o) ((o)->value.double_v)
-#define stringv(o) ((o)->value.string_v)
-#define errorv(o)  ((o)->value.error_v)
 #define bytev(o)   ((o)->value.byte_v)
 
+/**
+ * Pointer values aren't lvalues when NaN boxed, set them with
+ * setcellv(), setstringv(), setvectorv() and setarrayv(). stringv()
+ * is never one, small strings point into the object itself, and
+ * setstringv() makes a STRING_RAW string. cellv() never is either,
+ * the low bit of a cell pointer marks a cdr coded cell.
+ */
+#ifdef GENERAL_NANBOX
+#define cellv(o)   ((cell*)(uintptr_t)((o)->value.bits & NANBOX_PAYLOAD & ~1ull))
+#define ocdr_coded(o) ((o)->value.bits & 1)
+#define vectorv(o) ((vector*)(uintptr_t)((o)->value.bits & NANBOX_PAYLOAD))
+#define arrayv(o)  ((array*)(uintptr_t)((o)->value.bits & NANBOX_PAYLOAD))
+#define hashmapv(o) ((hashmap*)(uintptr_t)((o)->value.bits & NANBOX_PAYLOAD))
+#define unrolledv(o) ((unrolled*)(uintptr_t)((o)->value.bits & NANBOX_PAYLOAD))
+#define headedv(o) ((struct general_builder*)(uintptr_t)((o)->value.bits & NANBOX_PAYLOAD))
+#define dequev(o) ((deque*)(uintptr_t)((o)->value.bits & NANBOX_PAYLOAD))
+
+#define ostring_form(o)                                                 \
+  (((o)->value.bits & ~NANBOX_PAYLOAD) == NANBOX_SMALL_STRING ? STRING_SMALL : \
+   ((o)->value.bits & ~NANBOX_PAYLOAD) == NANBOX_RAW_STRING ? STRING_RAW : STRING_HEAP)
+#define stringv(o)                                                      \
+  (ostring_form(o) == STRING_SMALL ? (o)->value.small                   \
+   : (string)(uintptr_t)((o)->value.bits & NANBOX_PAYLOAD))
+#define errorv(o)  (stringv(o))
+#define symbolv(o) (stringv(o))
+
+#define nanbox_set(o, p)                                                \
+  ((o)->value.bits = ((o)->value.bits & ~NANBOX_PAYLOAD) | (uintptr_t)(p))
+#define setcellv(o, c)   (nanbox_set((o), (c)))
+#define setstringv(o, s)                                                \
+  ((o)->value.bits = (is(*(o), error) ? nanbox_box(error_ot) : NANBOX_RAW_STRING) | \
+   (uintptr_t)(s))
+#define setvectorv(o, v) (nanbox_set((o), (v)))
+#define setarrayv(o, a)  (nanbox_set((o), (a)))
+#else
+#define cellv(o)   ((cell*)((uintptr_t)(o)->value.cell_v & ~(uintptr_t)1))
+#define ocdr_coded(o) ((uintptr_t)(o)->value.cell_v & 1)
+#define vectorv(o) ((o)->value.vector_v)
+#define arrayv(o)  ((o)->value.array_v)
+#define hashmapv(o) ((o)->value.hashmap_v)
+#define unrolledv(o) ((o)->value.unrolled_v)
+#define headedv(o) ((o)->value.headed_v)
+#define dequev(o) ((o)->value.deque_v)
+
+#define ostring_form(o) ((o)->form)
+#define stringv(o)                                                      \
+  (ostring_form(o) == STRING_SMALL ? (o)->value.small : (o)->value.string_v)
+#define errorv(o)  ((o)->value.error_v)
+#define symbolv(o) ((o)->value.string_v)
+
+#define setcellv(o, c)   ((o)->value.cell_v = (c))
+#define setstringv(o, s) ((o)->form = STRING_RAW, (o)->value.string_v = (s))
+#define setvectorv(o, v) (vectorv(o) = (v))
+#define setarrayv(o, a)  (arrayv(o) = (a))
+#endif
+
+/**
+ * Cells more than one list shares, marked with how many lists beyond
+ * the first share them. 255 means shared for good. Changed and looked
+ * up under heap_lock, frees on any thread check it.
+ */
+struct general_ptrset shared_cells = { 0 };
+
+/**
+ * The cdr of each shared cell, numbered with the cell. A joint is
+ * never changed in place, so every list sharing the cell finds the
+ * same next cell through it. Under heap_lock.
+ */
+struct general_ptrmap shared_joints = { 0 };
+
+/**
+ * The next cell as o's cell holds it. A list oshare() made gets its
+ * original's header here, so this is for walks that only read.
+ */
+object* cell_next(object* o) {
+  return ocdr_coded(o) ? (object*)(&cellv(o)->car + 1) : cellv(o)->cdr;
+}
+
+object* share_next(object*);
+
+/**
+ * The next cell of a list, coded or not. Not an lvalue, set it with
+ * osetcdr(). Walking a list oshare() made gives it the cells it walks
+ * through.
+ */
+object* ocdr(object* o) {
+  if (__atomic_load_n(&shared_cells.count, __ATOMIC_RELAXED) && !ocdr_coded(o)) {
+    return share_next(o);
+  }
+  return cell_next(o);
+}
+
+/**
+ * The elements of an ints or doubles array.
+ */
+#define intsv(o)    ((int*)arrayv(o)->data)
+#define doublesv(o) ((double*)arrayv(o)->data)
+
+/**
+ * Longest string kept inline in an object.
+ */
+#ifdef GENERAL_NANBOX
+#define STRING_SMALL_MAX 5
+#else
+#define STRING_SMALL_MAX 7
+#endif
+
 #define numberv(o)                              \
   ({                                            \
     object __x = o;                             \
@@ -215,23 +858,276 @@ object make_byte(byte);
 
 object make_string(string);
 
-long int objects_allocated = 0;
-object** allocated_objects;
-long int allocated_objects_length = 0;
+object make_symbol(string);
 
+object make_cell(cell*);
 
-/**
- * Copy an object.
- */
+object make_vector(vector*);
+
+object make_ints(array*);
+
+object make_doubles(array*);
+
+object make_hashmap(hashmap*);
+
+object make_unrolled(unrolled*);
+
+object make_headed(struct general_builder*);
+
+object make_deque(deque*);
+
+/**
+ * Every live object this thread's heap has in the global slab.
+ * Region objects aren't here.
+ */
+#define objects_allocated (oheap()->count)
+#define allocated_objects (oheap()->objects)
+#define allocated_objects_length (oheap()->length)
+
+
+/* **************************************************************
+ * Garbage collection
+ * ************************************************************** */
+
+/**
+ * Objects that are always live.
+ */
+object** gc_roots = NULL;
+long int gc_roots_count = 0;
+long int gc_roots_length = 0;
+
+/**
+ * Collect after this many oalloc()s, 0 to only collect by hand. While
+ * more than one thread has a heap nothing is collected automatically:
+ * call ogc_collect() when the others are between jobs, with what they
+ * keep rooted, as only the calling thread's stack is scanned.
+ */
+long int gc_threshold = 0;
+__thread long int gc_allocated = 0;
+
+/**
+ * While above zero allocating neither starts nor steps a collection.
+ * The parallel operations hold it while their results are only in
+ * arrays the collector can't see.
+ */
+long int gc_held = 0;
+
+/**
+ * Also treat anything on the C stack that looks like an object as a
+ * root, from the collector's frame down to gc_stack_base.
+ */
+bool gc_scan_stack = true;
+__thread void* gc_stack_base = NULL;
+
+/**
+ * Turn on collection every threshold allocations. Objects held in the
+ * calling function and below it are found by scanning the stack.
+ */
+#define ogc_enable(threshold)                           \
+  do {                                                  \
+    if (!gc_stack_base)                                 \
+      gc_stack_base = __builtin_frame_address(0);       \
+    gc_threshold = (threshold);                         \
+  } while (0)
+
+/**
+ * What the collector is in the middle of.
+ */
+enum gc_phase {
+  GC_IDLE = 0,
+  GC_MARK = 1,
+  GC_SWEEP = 2
+};
+
+enum gc_phase gc_phase = GC_IDLE;
+
+/**
+ * Held while the collector works and while a thread takes a heap: a
+ * second heap going active abandons the cycle in flight, as nothing
+ * collects on its own while two are. Anything that queues or marks
+ * outside the collector checks the phase again under it.
+ */
+pthread_mutex_t gc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * With gc_incremental set, crossing gc_threshold starts a cycle and
+ * every oalloc() after that does one ogc_step() of it, instead of
+ * collecting everything at once.
+ */
+bool gc_incremental = false;
+
+/**
+ * Budget for one ogc_step(): units of work (an object traced or a
+ * slot swept), and nanoseconds if gc_step_ns isn't 0.
+ */
+long int gc_step_work = 1000;
+long int gc_step_ns = 0;
+
+/**
+ * Pause times of collector steps. histogram[i] counts pauses that
+ * took [2^i, 2^(i+1)) nanoseconds.
+ */
+struct general_gc_stats {
+  long int cycles;
+  long int pauses;
+  long long int total_ns;
+  long long int max_ns;
+  long int histogram[64];
+};
+
+struct general_gc_stats gc_stats = { 0 };
+
+/**
+ * Shade o if a cycle is marking. Anything that stores a pointer into
+ * a cell must do this, which osetcar() and osetcdr() do for you;
+ * plain car(x) = ... and cdr(x) = ... don't.
+ */
+#define ogc_barrier(o)                                          \
+  do {                                                          \
+    if (__atomic_load_n(&gc_phase, __ATOMIC_RELAXED) == GC_MARK) \
+      gc_barrier_push(o);                                       \
+  } while (0)
+
+void gc_barrier_push(object*);
+
+
+/**
+ * Copy an object. A list's spine is copied and its cars are shared.
+ */
 object* ocopy(object*);
 
+/**
+ * Copy a list and every list in its cars, strings copied like cons()
+ * does. Cells reached more than once are copied once, so shared
+ * structure and cycles come out the same. The graph is walked without
+ * recursion, numbering cells in a table of its own so the list is
+ * only read, and the copy is allocated in one go. Other containers in
+ * cars are shared like ocopy() does. A list and an oshare() of it that
+ * neither has written yet share cells, so they come out as one list.
+ */
+object* ocopy_deep(object*);
+
 /**
  * Allocate an object
  */
 object* oalloc(void);
 
 /**
- * Free object
+ * Take a slot from the slab.
+ */
+struct general_slot* slab_alloc(void);
+
+/**
+ * Give a slot back to the slab.
+ */
+void slab_free(struct general_slot*);
+
+/**
+ * Open a region and make it current.
+ */
+struct general_region* oregion_begin(void);
+
+/**
+ * Release everything allocated in the current region and close it.
+ */
+void oregion_end(struct general_region*);
+
+/**
+ * Copy an object, cars and strings included, out of the current region.
+ */
+object* opromote(object*);
+
+/**
+ * Allocate string storage, from the current region if there is one.
+ * Vector items and array elements are allocated here too.
+ */
+string ostring_alloc(long int);
+
+/**
+ * Free a string from ostring_alloc(). Anything else is left alone.
+ */
+void ostring_free(string);
+
+/**
+ * A STRING_HEAP copy of length bytes of s, in the current allocator.
+ */
+string ostring_new(string, long int);
+
+/**
+ * A string object with its own copy of the characters. Small strings
+ * and symbols are returned as they are.
+ */
+object string_copy(object*);
+
+/**
+ * Length of a string object, without a strlen() unless it is raw.
+ */
+long int ostring_length(object*);
+
+/**
+ * Hash of a string object's characters, cached by heap strings.
+ */
+uint64_t ostring_hash(object*);
+
+/**
+ * Keep an object, and everything it refers to, alive.
+ */
+void ogc_root(object*);
+
+/**
+ * Stop keeping an object alive.
+ */
+void ogc_unroot(object*);
+
+/**
+ * Free every unreachable object, cell and string, returns how many
+ * slots were freed.
+ */
+long int ogc_collect(void);
+
+/**
+ * Do up to gc_step_work units of collection, starting a cycle if none
+ * is running, returns how many slots were freed.
+ */
+long int ogc_step(void);
+
+/**
+ * Pause time, in nanoseconds, under which fraction p of pauses fell.
+ */
+long long int ogc_pause_percentile(double);
+
+/**
+ * Queue an object to be traced by the current cycle.
+ */
+void gc_push(object*);
+
+/**
+ * car(o) = value, through the write barrier.
+ */
+object* osetcar(object*, object);
+
+/**
+ * cdr(o) = value, through the write barrier.
+ */
+object* osetcdr(object*, object*);
+
+/**
+ * The interned copy of a string, made on first use.
+ */
+string ointern(string);
+
+/**
+ * Index of a pointer in the set, -1 if it isn't there.
+ */
+long int ptrset_find(struct general_ptrset*, void*);
+
+void ptrset_add(struct general_ptrset*, void*);
+
+void ptrset_remove(struct general_ptrset*, void*);
+
+/**
+ * Free object. Slots from another thread's heap go back to it, and
+ * that heap's strings are left to the collector.
  */
 int ofree(object*);
 
@@ -245,19 +1141,43 @@ object* cons(object, object*);
  */
 object oadd(object*);
 
+/**
+ * Add n args
+ */
+object oadd_n(object*, int);
+
 /**
  * Subtract args, if only one, negate.
  */
 object ominus(object*);
 
+/**
+ * Subtract n args, if only one, negate.
+ */
+object ominus_n(object*, int);
+
+/**
+ * Number of elements, O(1) for everything but a plain cons list.
+ */
 object olength(object*);
 
 object* olast(object*);
 
+/**
+ * A new list of the elements of each list in args, which are left as
+ * they are. Headed lists are appended like their lists.
+ */
 object* oappend(object*);
 
+/**
+ * Remove the first element and return a copy of it. A headed list
+ * keeps its length.
+ */
 object* opop(object*);
 
+/**
+ * Add elm to the front. A headed list keeps its length.
+ */
 object* opush(object, object*); 
 
 object* onumber_equal(object*, object*);
@@ -266,4 +1186,599 @@ object* ostring_equal(object*, object*);
 
 object* oequal(object*, object*);
 
+/**
+ * T if all n args are oequal().
+ */
+object* oequal_n(object*, int);
+
+/**
+ * Hash consistent with oequal(): objects that are oequal() hash the
+ * same, so int 3 and double 3.0 do. Lists are walked iteratively.
+ */
+uint64_t ohash(object*);
+
+/* **************************************************************
+ * List building
+ * ************************************************************** */
+
+/**
+ * Builds a list front to back. The last cell is kept, so adding to
+ * the end is O(1) instead of an olast() walk.
+ * example:
+ *   struct general_builder b = obuilder();
+ *   obuilder_add(&b, make_int(1));
+ *   object* list = obuilder_finish(&b);
+ */
+struct general_builder {
+  object* head;
+  object* last; /* NULL while empty */
+  long int length;
+};
+
+#define obuilder() ((struct general_builder){ NIL, NULL, 0 })
+
+/**
+ * Add value to the end, a string is copied like cons() does.
+ */
+void obuilder_add(struct general_builder*, object);
+
+/**
+ * Add each element of list to the end, O(length of list).
+ */
+void obuilder_add_list(struct general_builder*, object*);
+
+/**
+ * Move other's cells to the end in O(1), other is left empty.
+ */
+void obuilder_splice(struct general_builder*, struct general_builder*);
+
+/**
+ * The list built so far, an ordinary cons list. The builder is left
+ * empty.
+ */
+object* obuilder_finish(struct general_builder*);
+
+/* **************************************************************
+ * Headed lists
+ * ************************************************************** */
+
+/**
+ * A headed list is a cons list behind a header that keeps its length
+ * and last cell, so olength() and adding to either end are O(1). The
+ * cells are only in sync while they are changed through the header.
+ * Makes one over list, which is walked once and not copied.
+ */
+object* oheaded(object*);
+
+/**
+ * The cons list, NIL while empty.
+ */
+#define oheaded_list(o) (headedv(o)->head)
+
+/**
+ * Add value to the end, returns the headed list.
+ */
+object* oheaded_add(object*, object);
+
+/**
+ * Add each element of list to the end, returns the headed list.
+ */
+object* oheaded_append(object*, object*);
+
+/**
+ * Push elm on the front of a headed list with compare and swap, so
+ * any number of threads can push and pop at once without a lock.
+ * Returns the headed list.
+ */
+object* opush_atomic(object, object*);
+
+/**
+ * Pop the front element of a headed list, safe alongside other
+ * threads' opush_atomic() and opop_atomic(). Returns the element
+ * itself rather than a copy, nil when the list is empty. A popped
+ * cell from a region is left for oregion_end() to free.
+ */
+object opop_atomic(object*);
+
+/**
+ * A list of n ints, doubles or objects, strings copied like cons()
+ * does. The cells are allocated together, and unless the slab's free
+ * list is fragmented they sit side by side in memory.
+ */
+object* list_from_ints(const int*, long int);
+
+object* list_from_doubles(const double*, long int);
+
+object* list_from_objects(const object*, long int);
+
+/**
+ * Copy up to n cars of list into out, returns how many were copied.
+ */
+long int list_to_array(object*, object*, long int);
+
+/* **************************************************************
+ * Compact lists
+ * ************************************************************** */
+
+/**
+ * Runs of a cdr coded list are allocated in power of two sizes up to
+ * a slab page, aligned to their size.
+ */
+#define RUN_MIN_SIZE 256
+#define RUN_MAX_SIZE SLAB_PAGE_SIZE
+
+/**
+ * Every run, marked by the collector like owned_strings. Runs are
+ * added and removed under heap_lock.
+ */
+struct general_ptrset compact_runs = { 0 };
+
+/**
+ * A cdr coded copy of list, strings copied like cons() does. Cells
+ * take a header and a car, no cdr, and follow each other in memory.
+ * Setting a coded cell's cdr moves it to an ordinary cell, anything
+ * else works on either form. Runs are always in the global heap.
+ */
+object* ocompact(object*);
+
+/**
+ * The run p points into, NULL if it isn't in one. Runs are made and
+ * freed on any thread, so this takes heap_lock; the collector, which
+ * runs with one heap active, uses compact_run_find() without it.
+ */
+struct general_run* compact_run_of(void*);
+
+struct general_run* compact_run_find(void*);
+
+/* **************************************************************
+ * Shared lists
+ * ************************************************************** */
+
+/**
+ * When set, ocopy() and cons() share lists with oshare() instead of
+ * copying them.
+ */
+bool copy_on_write = false;
+
+/**
+ * A copy of list that shares its cells until it is walked or written.
+ * Every cell of the spine is counted in shared_cells, and either list
+ * takes a cell of its own for each one cdr(), osetcar(), osetcdr(),
+ * opush() or opop() reaches through it, so changing either list
+ * anywhere leaves the other as it was. A handle into the list taken
+ * before it was shared belongs to neither once written. Only one
+ * thread may walk a shared list at a time. A spine with coded, region
+ * or malloc'd cells is copied instead. ofree() stops at a shared cell
+ * and leaves the rest to the collector.
+ */
+object* oshare(object*);
+
+/* **************************************************************
+ * Argument vectors
+ * ************************************************************** */
+
+/**
+ * Args as an array on the stack, and how many there are.
+ * example: oadd_n(oargs(a, b), oargc(a, b))
+ */
+#define oargs(...) ((object[]){ __VA_ARGS__ })
+#define oargc(...) ((int)(sizeof((object[]){ __VA_ARGS__ }) / sizeof(object)))
+
+/**
+ * Call with args, no list needed.
+ * example: oadd_v(make_int(1), make_double(2.5))
+ */
+#define oadd_v(...)   (oadd_n(oargs(__VA_ARGS__), oargc(__VA_ARGS__)))
+#define ominus_v(...) (ominus_n(oargs(__VA_ARGS__), oargc(__VA_ARGS__)))
+#define oequal_v(...) (oequal_n(oargs(__VA_ARGS__), oargc(__VA_ARGS__)))
+
+/* **************************************************************
+ * Vectors
+ * ************************************************************** */
+
+/**
+ * Make an empty vector with room for capacity items.
+ */
+object* ovector(int);
+
+/**
+ * Make a vector of a list's cars.
+ */
+object* ovector_from_list(object*);
+
+/**
+ * Make a list of a vector's items.
+ */
+object* ovector_to_list(object*);
+
+/**
+ * Pointer to item i, NIL if out of range. Storing through it skips the
+ * write barrier, use ovector_set().
+ */
+object* ovector_ref(object*, int);
+
+/**
+ * items[i] = value, returns the vector or NIL if out of range.
+ */
+object* ovector_set(object*, int, object);
+
+/**
+ * Append value, growing the vector if it is full.
+ */
+object* ovector_push(object*, object);
+
+/**
+ * New vector of items [start, end), both clamped to the vector.
+ */
+object* ovector_slice(object*, int, int);
+
+/* **************************************************************
+ * Numeric arrays
+ * ************************************************************** */
+
+/**
+ * Make an empty ints or doubles array with room for capacity elements.
+ */
+object* oints(int);
+
+object* odoubles(int);
+
+/**
+ * Make an array of the numbers in a list or vector, doubles if any of
+ * them is a double, ints otherwise. NIL if one isn't a number.
+ */
+object* oarray_from(object*);
+
+/**
+ * Element i as an int or double object, nil if out of range.
+ */
+object oarray_ref(object*, int);
+
+/**
+ * elements[i] = value, returns the array, or NIL if i is out of range
+ * or value is a double and the array holds ints.
+ */
+object* oarray_set(object*, int, object);
+
+/**
+ * Append value, growing the array if it is full. NIL like oarray_set().
+ */
+object* oarray_push(object*, object);
+
+/**
+ * Sum of the elements, an int for ints and a double for doubles, like
+ * oadd().
+ */
+object oarray_sum(object*);
+
+/**
+ * Smallest and largest element, nil if the array is empty.
+ */
+object oarray_min(object*);
+
+object oarray_max(object*);
+
+/**
+ * Sum of a[i] * b[i], a double if either is doubles. nil if the
+ * lengths differ.
+ */
+object oarray_dot(object*, object*);
+
+/**
+ * Elementwise a + b, a - b and a * b as a new array, doubles if
+ * either is doubles. NIL if the lengths differ.
+ */
+object* oarray_add(object*, object*);
+
+object* oarray_sub(object*, object*);
+
+object* oarray_mul(object*, object*);
+
+/* **************************************************************
+ * Hash maps
+ * ************************************************************** */
+
+/**
+ * Make an empty hashmap with room for about capacity entries. Keys
+ * are compared with oequal() and hashed with ohash(), string keys are
+ * copied.
+ */
+object* ohashmap(int);
+
+/**
+ * Pointer to key's value, NULL if it isn't there. It is good until
+ * the next set or delete, and storing through it skips the write
+ * barrier, use ohashmap_set().
+ */
+object* ohashmap_get(object*, object*);
+
+/**
+ * Insert or replace key's value, returns the hashmap.
+ */
+object* ohashmap_set(object*, object, object);
+
+/**
+ * Remove key, T if it was there and NIL if not.
+ */
+object* ohashmap_delete(object*, object*);
+
+/**
+ * Number of entries.
+ */
+int ohashmap_count(object*);
+
+/**
+ * Step *i through the entries, false at the end. Start *i at 0.
+ */
+bool ohashmap_next(object*, long int*, object**, object**);
+
+/**
+ * Every key and value, in no particular order. Entries may not be
+ * added or removed in the body.
+ * example: ohashmap_for_each(key, value, map) { ... }
+ */
+#define ohashmap_for_each(key, value, map)                              \
+  for (long int key ## _i = 0, key ## _more = 1; key ## _more; key ## _more = 0) \
+    for (object *key = NULL, *value = NULL;                             \
+         ohashmap_next((map), &key ## _i, &key, &value);)
+
+/* **************************************************************
+ * Unrolled lists
+ * ************************************************************** */
+
+/**
+ * Make an empty unrolled list, a sequence stored UNROLLED_BLOCK
+ * objects at a time.
+ */
+object* ounrolled(void);
+
+/**
+ * Make an unrolled list of a list's cars, and a list of an unrolled
+ * list's items.
+ */
+object* ounrolled_from_list(object*);
+
+object* ounrolled_to_list(object*);
+
+/**
+ * Add value at the back or the front, returns the unrolled list.
+ */
+object* ounrolled_push(object*, object);
+
+object* ounrolled_push_front(object*, object);
+
+/**
+ * Remove and return the back or front item, nil if it is empty.
+ */
+object ounrolled_pop(object*);
+
+object ounrolled_pop_front(object*);
+
+/**
+ * Pointer to item i, NIL if out of range. Walks blocks from the
+ * nearer end. Storing through it skips the write barrier, use
+ * ounrolled_set().
+ */
+object* ounrolled_ref(object*, long int);
+
+/**
+ * Item i = value, returns the unrolled list or NIL if out of range.
+ */
+object* ounrolled_set(object*, long int, object);
+
+/**
+ * Every item of an unrolled list, front to back. Items may not be
+ * pushed or popped in the body.
+ * example: ounrolled_for_each(item, list) { ... }
+ */
+#define ounrolled_for_each(item, thing)                                 \
+  for (struct general_block* item ## _b = unrolledv(thing)->first;      \
+       item ## _b; item ## _b = NULL)                                   \
+    for (object* item = &item ## _b->items[item ## _b->start]; item;    \
+         item = item + 1 < &item ## _b->items[item ## _b->start + item ## _b->count] \
+           ? item + 1                                                   \
+           : (item ## _b = item ## _b->next) != unrolledv(thing)->first \
+           ? &item ## _b->items[item ## _b->start] : NULL)
+
+/* **************************************************************
+ * Deques
+ * ************************************************************** */
+
+/**
+ * Make an empty deque, a ring buffer with room for about capacity
+ * items before it grows. Pushing and popping at either end is O(1)
+ * and doesn't allocate until it is full.
+ */
+object* odeque(int);
+
+/**
+ * Make a deque of a list's cars, and a list of a deque's items.
+ */
+object* odeque_from_list(object*);
+
+object* odeque_to_list(object*);
+
+/**
+ * Add value at the back or the front, returns the deque.
+ */
+object* odeque_push(object*, object);
+
+object* odeque_push_front(object*, object);
+
+/**
+ * Remove and return the back or front item, nil if it is empty.
+ */
+object odeque_pop(object*);
+
+object odeque_pop_front(object*);
+
+/**
+ * Pointer to item i counted from the front, NIL if out of range.
+ * Storing through it skips the write barrier, use odeque_set().
+ */
+object* odeque_ref(object*, int);
+
+/**
+ * Item i = value, returns the deque or NIL if out of range.
+ */
+object* odeque_set(object*, int, object);
+
+#define deque_item(ring, i) (&(ring)->items[((ring)->head + (i)) & ((ring)->capacity - 1)])
+
+/**
+ * Every item of a deque, front to back. Items may not be pushed or
+ * popped in the body.
+ * example: odeque_for_each(item, queue) { ... }
+ */
+#define odeque_for_each(item, thing)                                    \
+  for (struct { struct general_ring* r; int i; } item ## _c = { dequev(thing)->ring, 0 }; \
+       item ## _c.r; item ## _c.r = NULL)                               \
+    for (object* item;                                                  \
+         item ## _c.i < item ## _c.r->length && (item = deque_item(item ## _c.r, item ## _c.i)); \
+         item ## _c.i++)
+
+/* **************************************************************
+ * Reference counting
+ * ************************************************************** */
+
+/**
+ * A count with this bit set is shared between threads and only
+ * changed with atomic operations.
+ */
+#define REFS_ATOMIC 0x80000000u
+
+#define orefs_word(o) (opage(o)->refs[oslot_index(o)])
+
+/**
+ * How many objects are counted, so ofree() and the collector can skip
+ * looking.
+ */
+long int refs_counted = 0;
+
+/**
+ * Count a reference to o, an object from oalloc() outside a region;
+ * anything else is returned uncounted. The first reference takes o,
+ * and what it refers to, off the collector's hands until the last is
+ * released. Returns o.
+ */
+object* oretain(object*);
+
+/**
+ * Drop a reference to o, freeing it with ofree() once the last one is
+ * gone, on whichever thread that is.
+ */
+void orelease(object*);
+
+/**
+ * Let other threads retain and release o, counting it if it isn't
+ * already: its count is changed with atomic operations from now on,
+ * while counts that stay on one thread keep the plain ones. Do it
+ * before o is handed over; other threads may only read o and retain
+ * or release it.
+ */
+object* oatomic(object*);
+
+/**
+ * References to o, 0 if it isn't counted.
+ */
+long int orefs(object*);
+
+/**
+ * Take back the slots other threads freed from this thread's heap,
+ * returns how many. Allocating does it as it goes.
+ */
+int ofree_released(void);
+
+/* **************************************************************
+ * Parallel operations
+ * ************************************************************** */
+
+/**
+ * Elements a thread takes at a time.
+ */
+#define PARALLEL_CHUNK 16384
+
+/**
+ * Anything shorter than this is mapped, filtered and reduced on the
+ * calling thread.
+ */
+long int parallel_threshold = 4 * PARALLEL_CHUNK;
+
+/**
+ * A fixed set of threads the parallel operations split their chunks
+ * over, the calling thread taking some too.
+ */
+struct general_pool {
+  pthread_t* threads;
+  int size;
+  pthread_mutex_t run;             /* held by the thread using the pool */
+  pthread_mutex_t lock;            /* guards the rest */
+  pthread_cond_t start;
+  pthread_cond_t finish;
+  void (*task)(void*, long int);
+  void* arg;
+  long int chunks;
+  long int next;                   /* next chunk to take */
+  long int done;                   /* chunks finished */
+  bool stopping;
+};
+
+struct general_pool* pool = NULL;
+
+/**
+ * Start n pool threads, 0 for one less than the cores online. Until
+ * then, and while another thread is using the pool, the parallel
+ * operations run serially. A pool thread that allocates has a heap
+ * until its share of the job is done, and while it does the collector
+ * doesn't run on its own (see gc_threshold).
+ */
+void opool_start(int);
+
+/**
+ * Stop and join the pool threads.
+ */
+void opool_stop(void);
+
+/**
+ * A new list of fn(elm) for each element of a list or headed list, a
+ * new vector for a vector. fn runs on the pool threads: it may only
+ * read what they share, and what it allocates comes from their heaps.
+ * Nothing is collected until the result is built. Strings are copied
+ * like cons() does.
+ */
+object* omap(object*, object (*)(object*));
+
+/**
+ * A new list, or vector, of the elements pred(elm) holds for, in
+ * order. pred runs on the pool threads like omap()'s fn.
+ */
+object* ofilter(object*, bool (*)(object*));
+
+/**
+ * fn(...fn(fn(init, a), b)..., z) for fn associative and init its
+ * identity: each chunk is folded from init on the pool, then the
+ * results are folded in order.
+ */
+object oreduce(object*, object (*)(object, object), object);
+
+/**
+ * oadd() summing chunks on the pool. Doubles may round differently
+ * than oadd()'s left to right sum.
+ */
+object oadd_parallel(object*);
+
+/**
+ * ocopy_deep() with the lists in cars copied by the pool threads, each
+ * working through its own queue of them and taking from the others'
+ * when it runs out. Shared structure, cycles and strings come out as
+ * ocopy_deep() makes them, and the list is likewise only read.
+ */
+object* ocopy_deep_parallel(object*);
+
+/**
+ * oequal() with the lists in cars compared by the pool threads like
+ * ocopy_deep_parallel() copies them, stopping at the first difference.
+ */
+object* oequal_parallel(object*, object*);
+
 #endif
@@ -0,0 +1,897 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jordon Biondo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <time.h>
+#include <pthread.h>
+#include "../src/object.c"
+
+/**
+ * Benchmarks, run with `make bench`, or pass group names to run only
+ * those: ./test/general_bench traverse gc
+ */
+
+double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define BENCH(name, n, body)                                    \
+  do {                                                          \
+    double __start = now();                                     \
+    body;                                                       \
+    double __elapsed = now() - __start;                         \
+    printf("%-32s %10.2f ns/op %12.0f ops/s\n", name,          \
+           __elapsed * 1e9 / (n), (n) / __elapsed);             \
+  } while (0)
+
+/* **************************************************************
+ * cons
+ * ************************************************************** */
+
+/**
+ * cons as it was before the slab: a malloc for the cell, one for
+ * the header and one for the copied car.
+ */
+object* malloc_cons(object a, object* b) {
+  cell* c = malloc(sizeof(cell));
+  object* car = malloc(sizeof(object));
+  *car = a;
+  c->car = *car;
+  c->cdr = b;
+  object* o = malloc(sizeof(object));
+  *o = make_cell(c);
+  return o;
+}
+
+void malloc_free(object* o) {
+  while (is(*o, cell)) {
+    object* next = cdr(o);
+    free(cellv(o));
+    free(o);
+    o = next;
+  }
+}
+
+void bench_cons(int rounds, int length) {
+  long int n = (long int)rounds * length;
+
+  BENCH("cons (malloc)", n, {
+      for (int r = 0; r < rounds; r++) {
+        object* l = NIL;
+        for (int i = 0; i < length; i++) {
+          l = malloc_cons(make_int(i), l);
+        }
+        malloc_free(l);
+      }
+    });
+
+  BENCH("cons (slab)", n, {
+      for (int r = 0; r < rounds; r++) {
+        object* l = NIL;
+        for (int i = 0; i < length; i++) {
+          l = cons(make_int(i), l);
+        }
+        ofree(l);
+      }
+    });
+  int* ints = malloc(sizeof(int) * length);
+  for (int i = 0; i < length; i++) {
+    ints[i] = i;
+  }
+  BENCH("list_from_ints", n, {
+      for (int r = 0; r < rounds; r++) {
+        ofree(list_from_ints(ints, length));
+      }
+    });
+  free(ints);
+}
+
+/**
+ * Appending rows one at a time, walking to the end each time as
+ * callers had to before the builder.
+ */
+void bench_append(int rows) {
+  BENCH("append (olast)", rows, {
+      object* l = list1(make_int(0));
+      for (int i = 1; i < rows; i++) {
+        osetcdr(olast(l), list1(make_int(i)));
+      }
+      ofree(l);
+    });
+
+  BENCH("append (builder)", rows, {
+      struct general_builder b = obuilder();
+      for (int i = 0; i < rows; i++) {
+        obuilder_add(&b, make_int(i));
+      }
+      ofree(obuilder_finish(&b));
+    });
+}
+
+/* **************************************************************
+ * argument passing
+ * ************************************************************** */
+
+void bench_args(int n) {
+  int sum = 0;
+  BENCH("oadd (list2 + ofree)", n, {
+      for (int i = 0; i < n; i++) {
+        object* args = list2(make_int(i), make_int(1));
+        sum += oadd(args).value.int_v;
+        ofree(args);
+      }
+    });
+  BENCH("oadd_v", n, {
+      for (int i = 0; i < n; i++) {
+        sum += oadd_v(make_int(i), make_int(1)).value.int_v;
+      }
+    });
+  if (sum == 42) {
+    printf("\n");
+  }
+}
+
+/* **************************************************************
+ * interning
+ * ************************************************************** */
+
+void bench_intern(int rounds, int length) {
+  static const char* keys[] = { "id", "name", "timestamp", "user_agent", "status" };
+  object* strings = NIL;
+  object* strings2 = NIL;
+  object* symbols = NIL;
+  object* symbols2 = NIL;
+  for (int i = 0; i < length; i++) {
+    strings = cons(make_string((string)keys[i % 5]), strings);
+    strings2 = cons(make_string((string)keys[i % 5]), strings2);
+    symbols = cons(make_symbol((string)keys[i % 5]), symbols);
+    symbols2 = cons(make_symbol((string)keys[i % 5]), symbols2);
+  }
+  printf("%-32s %10ld strings\n", "owned (strings)", owned_strings.count);
+  printf("%-32s %10ld strings\n", "interned (symbols)", intern_table.count);
+
+  long int equal = 0;
+  BENCH("oequal (strings)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        equal += otruthy(*oequal(strings, strings2));
+      }
+    });
+  BENCH("oequal (symbols)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        equal += otruthy(*oequal(symbols, symbols2));
+      }
+    });
+  uint64_t hash = 0;
+  BENCH("ohash (strings)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        hash ^= ohash(strings);
+      }
+    });
+  if (equal == 42 || hash == 42) {
+    printf("\n");
+  }
+  ofree(strings);
+  ofree(strings2);
+  ofree(symbols);
+  ofree(symbols2);
+}
+
+/* **************************************************************
+ * strings
+ * ************************************************************** */
+
+void bench_strings(int rounds, int length) {
+  static const char* words[] = { "id", "name", "status", "a much longer description" };
+  long int owned = owned_strings.count;
+  object* l = NIL;
+  BENCH("make_string + cons", length, {
+      for (int i = 0; i < length; i++) {
+        l = cons(make_string((string)words[i % 4]), l);
+      }
+    });
+  printf("%-32s %10ld strings\n", "owned", owned_strings.count - owned);
+
+  long int total = 0;
+  BENCH("ostring_length", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        ofor_each(s, head, l) {
+          total += ostring_length(s);
+        }
+      }
+    });
+  BENCH("ostring_hash", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        ofor_each(s, head, l) {
+          total += ostring_hash(s);
+        }
+      }
+    });
+  object* copy = NULL;
+  BENCH("ocopy", length, {
+      copy = ocopy(l);
+    });
+  object* deep = NULL;
+  BENCH("ocopy_deep", length, {
+      deep = ocopy_deep(l);
+    });
+  ofree(deep);
+  object* shared = NULL;
+  BENCH("oshare + osetcar", length, {
+      shared = oshare(l);
+      osetcar(shared, make_int(0));
+    });
+  if (total == 42) {
+    printf("\n");
+  }
+  ofree(shared);
+  ofree(copy);
+  ofree(l);
+}
+
+/* **************************************************************
+ * hash maps
+ * ************************************************************** */
+
+void bench_hashmap(int rounds, int size) {
+  object* alist = NIL;
+  object* map = ohashmap(0);
+  object* keys = ovector(size);
+  char buffer[32];
+  for (int i = 0; i < size; i++) {
+    sprintf(buffer, "route/%d", i);
+    object key = make_string(buffer);
+    alist = cons(*list2(key, make_int(i)), alist);
+    ohashmap_set(map, key, make_int(i));
+    ovector_push(keys, car(&car(alist)));
+  }
+
+  long int found = 0;
+  BENCH("assoc list lookup", (long int)rounds * size, {
+      for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < size; i++) {
+          ofor_each(entry, head, alist) {
+            if (otruthy(*oequal(&car(entry), ovector_ref(keys, i)))) {
+              found++;
+              break;
+            }
+          }
+        }
+      }
+    });
+  BENCH("ohashmap_get", (long int)rounds * size, {
+      for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < size; i++) {
+          found += ohashmap_get(map, ovector_ref(keys, i)) != NULL;
+        }
+      }
+    });
+  BENCH("ohashmap_set (growing)", (long int)size * 100, {
+      object* grown = ohashmap(0);
+      for (int i = 0; i < size * 100; i++) {
+        ohashmap_set(grown, make_int(i), make_int(i));
+      }
+      ofree(grown);
+    });
+  if (found == 42) {
+    printf("\n");
+  }
+  ofree(map);
+  ofree(keys);
+}
+
+/* **************************************************************
+ * traversal
+ * ************************************************************** */
+
+void bench_traverse(int rounds, int length) {
+  object* l = NIL;
+  for (int i = 0; i < length; i++) {
+    l = cons(make_int(i), l);
+  }
+  printf("%-32s %10zu bytes/node\n", "list node", sizeof(struct general_slot));
+
+  long int sum = 0;
+  BENCH("ofor_each", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        ofor_each(elm, head, l) {
+          sum += intv(elm);
+        }
+      }
+    });
+
+  object* c = ocompact(l);
+  printf("%-32s %10zu bytes/node\n", "compact node", sizeof(struct general_packed));
+  BENCH("ofor_each (compact)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        ofor_each(elm, head, c) {
+          sum += intv(elm);
+        }
+      }
+    });
+  ofree(c);
+
+  object* v = ovector_from_list(l);
+  printf("%-32s %10zu bytes/item\n", "vector item", sizeof(object));
+  BENCH("vector index", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        vector* items = vectorv(v);
+        for (int i = 0; i < items->length; i++) {
+          sum += intv(&items->items[i]);
+        }
+      }
+    });
+
+  object* u = ounrolled_from_list(l);
+  printf("%-32s %10zu bytes/item\n", "unrolled item",
+         sizeof(struct general_block) / UNROLLED_BLOCK);
+  BENCH("ounrolled_for_each", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        ounrolled_for_each(elm, u) {
+          sum += intv(elm);
+        }
+      }
+    });
+  BENCH("ounrolled push+pop_front", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < length; i++) {
+          ounrolled_push(u, ounrolled_pop_front(u));
+        }
+      }
+    });
+  ofree(u);
+
+  BENCH("olength (list)", 10, {
+      for (int r = 0; r < 10; r++) {
+        sum += olength(l).value.int_v;
+      }
+    });
+  BENCH("olength (vector)", 10, {
+      for (int r = 0; r < 10; r++) {
+        sum += olength(v).value.int_v;
+      }
+    });
+  object* h = oheaded(l);
+  BENCH("olength (headed)", 10, {
+      for (int r = 0; r < 10; r++) {
+        sum += olength(h).value.int_v;
+      }
+    });
+  if (sum == 42) {
+    printf("\n");
+  }
+  ofree(v);
+  ofree(h);
+}
+
+/* **************************************************************
+ * numeric arrays
+ * ************************************************************** */
+
+void bench_array(int rounds, int length) {
+  object* l = NIL;
+  object* ints = oints(length);
+  object* doubles = odoubles(length);
+  for (int i = 0; i < length; i++) {
+    l = cons(make_double(i * 0.5), l);
+    oarray_push(ints, make_int(i));
+    oarray_push(doubles, make_double(i * 0.5));
+  }
+
+  double sum = 0;
+  BENCH("oadd (list of doubles)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        sum += oadd(l).value.double_v;
+      }
+    });
+  BENCH("oarray_sum (doubles)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        sum += oarray_sum(doubles).value.double_v;
+      }
+    });
+  BENCH("oarray_sum (ints)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        sum += oarray_sum(ints).value.int_v;
+      }
+    });
+  BENCH("oarray_dot (doubles)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        sum += oarray_dot(doubles, doubles).value.double_v;
+      }
+    });
+  BENCH("oarray_max (ints)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        sum += oarray_max(ints).value.int_v;
+      }
+    });
+  BENCH("oarray_add (doubles)", (long int)rounds * length, {
+      for (int r = 0; r < rounds; r++) {
+        ofree(oarray_add(doubles, doubles));
+      }
+    });
+  if (sum == 42) {
+    printf("\n");
+  }
+  ofree(l);
+  ofree(ints);
+  ofree(doubles);
+}
+
+/* **************************************************************
+ * regions
+ * ************************************************************** */
+
+void bench_region(int rounds, int length) {
+  long int n = (long int)rounds * length;
+
+  BENCH("build + ofree", n, {
+      for (int r = 0; r < rounds; r++) {
+        object* l = NIL;
+        for (int i = 0; i < length; i++) {
+          l = cons(make_string("row"), l);
+        }
+        ofor_each(elm, head, l) {
+          ostring_free(stringv(elm));
+        }
+        ofree(l);
+      }
+    });
+
+  BENCH("build + oregion_end", n, {
+      for (int r = 0; r < rounds; r++) {
+        oregion(region) {
+          object* l = NIL;
+          for (int i = 0; i < length; i++) {
+            l = cons(make_string("row"), l);
+          }
+        }
+      }
+    });
+}
+
+/* **************************************************************
+ * work queues
+ * ************************************************************** */
+
+/**
+ * A queue holding depth items, each op takes one off and puts one on.
+ */
+void bench_queue(long int n, int depth) {
+  object* l = list_alloc(depth);
+  BENCH("opush + opop (list)", n, {
+      for (long int i = 0; i < n; i++) {
+        opush(make_int(i), l);
+        opop(l);
+      }
+    });
+
+  object* h = oheaded(NIL);
+  for (int i = 0; i < depth; i++) {
+    oheaded_add(h, make_int(i));
+  }
+  BENCH("oheaded_add + opop", n, {
+      for (long int i = 0; i < n; i++) {
+        oheaded_add(h, make_int(i));
+        opop(h);
+      }
+    });
+
+  object* q = odeque(depth);
+  for (int i = 0; i < depth; i++) {
+    odeque_push(q, make_int(i));
+  }
+  long int sum = 0;
+  BENCH("odeque_push + odeque_pop_front", n, {
+      for (long int i = 0; i < n; i++) {
+        odeque_push(q, make_int(i));
+        object x = odeque_pop_front(q);
+        sum += intv(&x);
+      }
+    });
+  if (sum == 42) {
+    printf("\n");
+  }
+  ogc_collect();
+}
+
+/* **************************************************************
+ * reference counts
+ * ************************************************************** */
+
+void bench_refs(long int n) {
+  object* l = oretain(list1(make_int(1)));
+  BENCH("oretain + orelease", n, {
+      for (long int i = 0; i < n; i++) {
+        oretain(l);
+        orelease(l);
+      }
+    });
+
+  oatomic(l);
+  BENCH("oretain + orelease (atomic)", n, {
+      for (long int i = 0; i < n; i++) {
+        oretain(l);
+        orelease(l);
+      }
+    });
+  orelease(l);
+
+  BENCH("list1 + oretain + orelease", n / 10, {
+      for (long int i = 0; i < n / 10; i++) {
+        orelease(oretain(list1(make_int(i))));
+      }
+    });
+
+  /* all counted at once, released in the order they were retained */
+  object** live = malloc(sizeof(object*) * (n / 10));
+  for (long int i = 0; i < n / 10; i++) {
+    live[i] = list1(make_int(i));
+  }
+  BENCH("oretain all + orelease all", n / 10, {
+      for (long int i = 0; i < n / 10; i++) {
+        oretain(live[i]);
+      }
+      for (long int i = 0; i < n / 10; i++) {
+        orelease(live[i]);
+      }
+    });
+  free(live);
+  ogc_collect();
+}
+
+/* **************************************************************
+ * threads
+ * ************************************************************** */
+
+struct alloc_job {
+  long int rounds;
+  int length;
+};
+
+void* alloc_worker(void* arg) {
+  struct alloc_job* job = arg;
+  for (long int r = 0; r < job->rounds; r++) {
+    object* l = NIL;
+    for (int i = 0; i < job->length; i++) {
+      l = cons(make_int(i), l);
+    }
+    ofree(l);
+  }
+  return NULL;
+}
+
+/**
+ * cons + ofree on 1 to max threads at once, each with its own heap.
+ * ns/op is wall time over every thread's conses.
+ */
+void bench_threads(int max, long int rounds, int length) {
+  pthread_t threads[64];
+  struct alloc_job job = { rounds, length };
+  for (int n = 1; n <= max; n *= 2) {
+    char name[64];
+    snprintf(name, sizeof(name), "cons + ofree, %d threads", n);
+    BENCH(name, (double)n * rounds * length, {
+        for (int t = 0; t < n; t++) {
+          pthread_create(&threads[t], NULL, alloc_worker, &job);
+        }
+        for (int t = 0; t < n; t++) {
+          pthread_join(threads[t], NULL);
+        }
+      });
+  }
+}
+
+/* **************************************************************
+ * shared stacks
+ * ************************************************************** */
+
+struct stack_job {
+  object* stack;
+  long int n;
+  pthread_mutex_t* lock; /* NULL for the lock-free stack */
+};
+
+void* stack_worker(void* arg) {
+  struct stack_job* job = arg;
+  for (long int i = 0; i < job->n; i++) {
+    if (job->lock) {
+      pthread_mutex_lock(job->lock);
+      opush(make_int(i), job->stack);
+      pthread_mutex_unlock(job->lock);
+      pthread_mutex_lock(job->lock);
+      opop(job->stack);
+      pthread_mutex_unlock(job->lock);
+    } else {
+      opush_atomic(make_int(i), job->stack);
+      opop_atomic(job->stack);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Threads pushing and popping one shared headed list, lock-free or
+ * behind a mutex. ns/op is wall time per push + pop.
+ */
+void bench_stack(int max, long int n) {
+  pthread_t threads[64];
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  object* stack = oheaded(NIL);
+  ogc_root(stack);
+  for (int locked = 0; locked < 2; locked++) {
+    for (int t = 1; t <= max; t *= 2) {
+      struct stack_job job = { stack, n, locked ? &lock : NULL };
+      char name[64];
+      snprintf(name, sizeof(name), "%s, %d threads",
+               locked ? "opush + opop (mutex)" : "opush_atomic + opop_atomic", t);
+      BENCH(name, (double)t * n, {
+          for (int i = 0; i < t; i++) {
+            pthread_create(&threads[i], NULL, stack_worker, &job);
+          }
+          for (int i = 0; i < t; i++) {
+            pthread_join(threads[i], NULL);
+          }
+        });
+    }
+  }
+  ogc_unroot(stack);
+  ogc_collect();
+}
+
+/* **************************************************************
+ * parallel map, filter and reduce
+ * ************************************************************** */
+
+object parallel_double(object* x) {
+  return make_int(intv(x) * 2);
+}
+
+bool parallel_even(object* x) {
+  return intv(x) % 2 == 0;
+}
+
+object parallel_plus(object a, object b) {
+  return make_int(intv(&a) + intv(&b));
+}
+
+void bench_parallel(int max, int rounds, long int n) {
+  int* xs = malloc(sizeof(int) * n);
+  for (long int i = 0; i < n; i++) {
+    xs[i] = i % 1000;
+  }
+  object* list = list_from_ints(xs, n);
+  object* vec = ovector_from_list(list);
+  ogc_root(list);
+  ogc_root(vec);
+  free(xs);
+
+  BENCH("oadd, serial", (double)rounds * n, {
+      for (int r = 0; r < rounds; r++) {
+        oadd(list);
+      }
+    });
+  for (int t = 1; t <= max; t *= 2) {
+    /* the calling thread takes chunks too */
+    if (t > 1) {
+      opool_start(t - 1);
+    }
+    for (int kind = 0; kind < 2; kind++) {
+      object* o = kind ? vec : list;
+      const char* of = kind ? "vector" : "list";
+      char name[64];
+      snprintf(name, sizeof(name), "oadd_parallel %s, %d threads", of, t);
+      BENCH(name, (double)rounds * n, {
+          for (int r = 0; r < rounds; r++) {
+            oadd_parallel(o);
+          }
+        });
+      snprintf(name, sizeof(name), "oreduce %s, %d threads", of, t);
+      BENCH(name, (double)rounds * n, {
+          for (int r = 0; r < rounds; r++) {
+            oreduce(o, parallel_plus, make_int(0));
+          }
+        });
+      snprintf(name, sizeof(name), "omap %s, %d threads", of, t);
+      BENCH(name, (double)rounds * n, {
+          for (int r = 0; r < rounds; r++) {
+            ofree(omap(o, parallel_double));
+          }
+        });
+      snprintf(name, sizeof(name), "ofilter %s, %d threads", of, t);
+      BENCH(name, (double)rounds * n, {
+          for (int r = 0; r < rounds; r++) {
+            ofree(ofilter(o, parallel_even));
+          }
+        });
+    }
+    opool_stop();
+  }
+  ogc_unroot(vec);
+  ogc_unroot(list);
+  ogc_collect();
+}
+
+/* **************************************************************
+ * parallel tree copy and compare
+ * ************************************************************** */
+
+object* bench_tree(int width, int depth) {
+  object* list = NIL;
+  for (int i = 0; i < width; i++) {
+    list = cons(depth > 1 ? *bench_tree(width, depth - 1) : make_int(i), list);
+  }
+  return list;
+}
+
+void bench_trees(int max, int rounds, int width, int depth) {
+  object* tree = bench_tree(width, depth);
+  ogc_root(tree);
+  object* other = ocopy_deep(tree);
+  ogc_root(other);
+  double cells = 0;
+  for (int d = 1, w = width; d <= depth; d++, w *= width) {
+    cells += w;
+  }
+
+  BENCH("ocopy_deep, serial", rounds * cells, {
+      for (int r = 0; r < rounds; r++) {
+        ocopy_deep(tree);
+        ogc_collect();
+      }
+    });
+  BENCH("oequal, serial", rounds * cells, {
+      for (int r = 0; r < rounds; r++) {
+        oequal(tree, other);
+      }
+    });
+  for (int t = 2; t <= max; t *= 2) {
+    /* the calling thread works too */
+    opool_start(t - 1);
+    char name[64];
+    snprintf(name, sizeof(name), "ocopy_deep_parallel, %d threads", t);
+    BENCH(name, rounds * cells, {
+        for (int r = 0; r < rounds; r++) {
+          ocopy_deep_parallel(tree);
+          ogc_collect();
+        }
+      });
+    snprintf(name, sizeof(name), "oequal_parallel, %d threads", t);
+    BENCH(name, rounds * cells, {
+        for (int r = 0; r < rounds; r++) {
+          oequal_parallel(tree, other);
+        }
+      });
+    opool_stop();
+  }
+  ogc_unroot(other);
+  ogc_unroot(tree);
+  ogc_collect();
+}
+
+/* **************************************************************
+ * gc pauses
+ * ************************************************************** */
+
+void bench_gc_pauses(int heap, int churn) {
+  ogc_collect();
+  object* live = NIL;
+  for (int i = 0; i < heap; i++) {
+    live = cons(make_int(i), live);
+  }
+  ogc_root(live);
+
+  gc_stats = (struct general_gc_stats){ 0 };
+  long long int start = gc_now_ns();
+  ogc_collect();
+  printf("heap %8d  stop the world  pause %10.3f ms\n",
+         heap, (gc_now_ns() - start) / 1e6);
+
+  gc_stats = (struct general_gc_stats){ 0 };
+  gc_incremental = true;
+  gc_threshold = 10000;
+  for (int i = 0; i < churn; i++) {
+    cons(make_int(i), NIL);
+  }
+  gc_incremental = false;
+  gc_threshold = 0;
+  while (gc_phase != GC_IDLE) {
+    ogc_step();
+  }
+  printf("heap %8d  incremental     p50 %8lld ns  p99 %8lld ns  max %8lld ns  (%ld cycles)\n",
+         heap, ogc_pause_percentile(0.5), ogc_pause_percentile(0.99),
+         gc_stats.max_ns, gc_stats.cycles);
+
+  ogc_unroot(live);
+  ogc_collect();
+}
+
+/**
+ * Was this group asked for?
+ */
+bool want(int argc, char** argv, const char* group) {
+  if (argc < 2) {
+    return true;
+  }
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], group) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int main (int argc, char** argv) {
+  if (want(argc, argv, "cons")) {
+    bench_cons(100, 100000);
+  }
+  if (want(argc, argv, "append")) {
+    bench_append(20000);
+  }
+  if (want(argc, argv, "region")) {
+    bench_region(100, 100000);
+  }
+  if (want(argc, argv, "args")) {
+    bench_args(10000000);
+  }
+  if (want(argc, argv, "intern")) {
+    bench_intern(10, 100000);
+  }
+  if (want(argc, argv, "strings")) {
+    bench_strings(20, 100000);
+  }
+  if (want(argc, argv, "hashmap")) {
+    bench_hashmap(10, 1000);
+  }
+  if (want(argc, argv, "queue")) {
+    bench_queue(10000000, 1000);
+  }
+  if (want(argc, argv, "refs")) {
+    bench_refs(10000000);
+  }
+  if (want(argc, argv, "threads")) {
+    bench_threads(8, 100, 100000);
+  }
+  if (want(argc, argv, "stack")) {
+    bench_stack(8, 1000000);
+  }
+  if (want(argc, argv, "parallel")) {
+    bench_parallel(8, 10, 10000000);
+  }
+  if (want(argc, argv, "trees")) {
+    bench_trees(8, 5, 8, 7);
+  }
+  if (want(argc, argv, "traverse")) {
+    bench_traverse(20, 1000000);
+  }
+  if (want(argc, argv, "array")) {
+    bench_array(20, 1000000);
+  }
+
+  if (want(argc, argv, "gc")) {
+    gc_scan_stack = false;
+    bench_gc_pauses(100000, 2000000);
+    bench_gc_pauses(1000000, 2000000);
+    bench_gc_pauses(4000000, 2000000);
+  }
+  return 0;
+}
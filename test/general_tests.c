@@ -21,6 +21,7 @@
  * THE SOFTWARE.
  */
 
+#include <pthread.h>
 #include "../src/object.c"
 #include "greatest/greatest.h"
 
@@ -114,6 +115,41 @@ TEST adding_mixed () {
   PASS();
 }
 
+TEST args_test () {
+  long int current_allocs = objects_allocated;
+  object sum = oadd_v(make_int(3), make_int(4));
+  ASSERT(is(sum, int));
+  ASSERT_EQ(intv(&sum), 7);
+  sum = oadd_v(make_int(3), make_double(0.5), make_int(4));
+  ASSERT(is(sum, double));
+  ASSERT_EQ(doublev(&sum), 7.5);
+  sum = oadd_v();
+  ASSERT_EQ(intv(&sum), 0);
+
+  object diff = ominus_v(make_int(10), make_int(3), make_int(2));
+  ASSERT(is(diff, int));
+  ASSERT_EQ(intv(&diff), 5);
+  diff = ominus_v(make_double(2.5));
+  ASSERT(is(diff, double));
+  ASSERT_EQ(doublev(&diff), -2.5);
+
+  ASSERT(otruthy(*oequal_v(make_int(2), make_double(2), make_int(2))));
+  ASSERT(ofalsy(*oequal_v(make_int(2), make_int(2), make_int(3))));
+  ASSERT(otruthy(*oequal_v(make_int(2))));
+  ASSERT_EQ(current_allocs, objects_allocated);
+
+  object args[] = { make_int(1), make_int(2), make_int(3), make_int(4) };
+  ASSERT_EQ(oadd_n(args, 4).value.int_v, 10);
+  ASSERT_EQ(ominus_n(args, 4).value.int_v, -8);
+  ASSERT_EQ(ominus_n(args, 0).value.int_v, 0);
+
+  object* list = list4(args[0], args[1], args[2], args[3]);
+  ASSERT_EQ(ominus(list).value.int_v, -8);
+  ASSERT_EQ(ominus(list1(make_int(3))).value.int_v, -3);
+  ASSERT_EQ(ominus(ovector_from_list(list)).value.int_v, -8);
+  PASS();
+}
+
 TEST number_equal_int() {
   object a = make_int(1);
   object b = make_int(90000);
@@ -194,6 +230,106 @@ TEST number_equal_mixed() {
   PASS();
 }
 
+TEST array_test () {
+  object* ints = oarray_from(list3(make_int(3), make_int(-4), make_int(5)));
+  ASSERT(is(*ints, ints));
+  ASSERT_EQ(olength(ints).value.int_v, 3);
+  object x = oarray_ref(ints, 1);
+  ASSERT(is(x, int));
+  ASSERT_EQ(intv(&x), -4);
+  ASSERT(is(oarray_ref(ints, 3), nil));
+  ASSERT(is(*oarray_push(ints, make_double(1.5)), nil));
+  ASSERT(is(*oarray_set(ints, 0, make_string("no")), nil));
+
+  object sum = oadd(ints);
+  ASSERT(is(sum, int));
+  ASSERT_EQ(intv(&sum), 4);
+  object min = oarray_min(ints);
+  object max = oarray_max(ints);
+  ASSERT_EQ(intv(&min), -4);
+  ASSERT_EQ(intv(&max), 5);
+  ASSERT(is(oarray_min(oints(0)), nil));
+
+  object* doubles = oarray_from(list3(make_int(1), make_double(0.5), make_int(2)));
+  ASSERT(is(*doubles, doubles));
+  sum = oadd(doubles);
+  ASSERT(is(sum, double));
+  ASSERT_EQ(doublev(&sum), 3.5);
+  ASSERT(oarray_set(doubles, 2, make_int(4)) == doubles);
+  x = oarray_ref(doubles, 2);
+  ASSERT(is(x, double));
+  ASSERT_EQ(doublev(&x), 4);
+
+  object dot = oarray_dot(ints, ints);
+  ASSERT(is(dot, int));
+  ASSERT_EQ(intv(&dot), 9 + 16 + 25);
+  dot = oarray_dot(ints, doubles);
+  ASSERT(is(dot, double));
+  ASSERT_EQ(doublev(&dot), 3 - 2 + 20);
+  ASSERT(is(oarray_dot(ints, oints(0)), nil));
+
+  object* added = oarray_add(ints, doubles);
+  ASSERT(is(*added, doubles));
+  ASSERT(otruthy(*oequal(added, oarray_from(list3(make_int(4), make_double(-3.5), make_int(9))))));
+  object* squared = oarray_mul(ints, ints);
+  ASSERT(is(*squared, ints));
+  ASSERT(otruthy(*oequal(squared, oarray_from(list3(make_int(9), make_int(16), make_int(25))))));
+  ASSERT(is(*oarray_sub(ints, oints(0)), nil));
+
+  object* copy = ocopy(ints);
+  ASSERT(arrayv(copy) != arrayv(ints));
+  ASSERT(otruthy(*oequal(copy, ints)));
+  ASSERT(ofalsy(*oequal(ints, doubles)));
+
+  gc_scan_stack = false;
+  ogc_root(doubles);
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 1);
+  ASSERT_EQ(owned_strings.count, 1);
+  ASSERT_EQ(oarray_sum(doubles).value.double_v, 5.5);
+  ogc_unroot(doubles);
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST array_kernel_test () {
+  /* every length up to a few registers, so tails are covered */
+  for (int n = 1; n < 40; n++) {
+    object* a = oints(n);
+    object* b = odoubles(n);
+    int isum = 0;
+    int imin = INT_MAX;
+    int imax = INT_MIN;
+    double dsum = 0;
+    double dot = 0;
+    for (int i = 0; i < n; i++) {
+      int v = (i * 7919 + n * 31) % 101 - 50;
+      oarray_push(a, make_int(v));
+      oarray_push(b, make_double(v * 0.25));
+      isum += v;
+      imin = v < imin ? v : imin;
+      imax = v > imax ? v : imax;
+      dsum += v * 0.25;
+      dot += v * v * 0.25;
+    }
+    ASSERT_EQ(oarray_sum(a).value.int_v, isum);
+    ASSERT_EQ(oarray_min(a).value.int_v, imin);
+    ASSERT_EQ(oarray_max(a).value.int_v, imax);
+    ASSERT_EQ(oarray_sum(b).value.double_v, dsum);
+    ASSERT_EQ(oarray_min(b).value.double_v, imin * 0.25);
+    ASSERT_EQ(oarray_max(b).value.double_v, imax * 0.25);
+    ASSERT_EQ(oarray_dot(a, b).value.double_v, dot);
+
+    object* diff = oarray_sub(oarray_add(a, a), a);
+    ASSERT(otruthy(*oequal(diff, a)));
+    object* scaled = oarray_mul(b, a);
+    for (int i = 0; i < n; i++) {
+      ASSERT_EQ(doublesv(scaled)[i], intsv(a)[i] * doublesv(b)[i]);
+    }
+  }
+  PASS();
+}
+
 TEST list_length () {
   object* l0 = NIL;
   object l0length = olength(l0);
@@ -216,7 +352,7 @@ TEST list_length () {
   ASSERT_EQ(intv(&l4length), 4);
 
   object* l5 = list4(*T, *T, *T, *T);
-  cdr(cdr(cdr(cdr(l5)))) = l4;
+  osetcdr(cdr(cdr(cdr(l5))), l4);
   object l5length = olength(l5);
   ASSERT_EQ(intv(&l5length), 8);
   PASS();
@@ -249,6 +385,137 @@ TEST list_append () {
   PASS();
 }
 
+TEST list_builder_test () {
+  struct general_builder b = obuilder();
+  ASSERT(is(*obuilder_finish(&b), nil));
+  for (int i = 0; i < 10000; i++) {
+    obuilder_add(&b, make_int(i));
+  }
+  ASSERT_EQ(b.length, 10000);
+
+  struct general_builder rest = obuilder();
+  char text[] = "a builder string";
+  obuilder_add(&rest, make_string(text));
+  obuilder_add_list(&rest, list2(make_int(1), make_int(2)));
+  obuilder_splice(&b, &rest);
+  ASSERT(rest.last == NULL);
+  ASSERT_EQ(b.length, 10003);
+
+  object* l = obuilder_finish(&b);
+  ASSERT(b.last == NULL);
+  ASSERT_EQ(olength(l).value.int_v, 10003);
+  int i = 0;
+  ofor_each(elm, head, l) {
+    if (i < 10000) {
+      ASSERT_EQ(intv(elm), i);
+    } else if (i == 10000) {
+      ASSERT(stringv(elm) != text);
+    }
+    i++;
+  }
+
+  object* l3 = list3(make_int(1), make_int(2), make_int(3));
+  object* appended = oappend(list2(*l3, *l3));
+  ASSERT_EQ(olength(appended).value.int_v, 6);
+  ASSERT_EQ(olength(l3).value.int_v, 3);
+  ASSERT(is(*oappend(NIL), nil));
+  PASS();
+}
+
+TEST list_bulk_test () {
+  int ints[5000];
+  for (int i = 0; i < 5000; i++) {
+    ints[i] = i;
+  }
+  /* the slots of a freed list come back off the free list in reverse */
+  ofree(list_from_ints(ints, 5000));
+  long int objects = objects_allocated;
+  object* l = list_from_ints(ints, 5000);
+  ASSERT_EQ(objects_allocated, objects + 5000);
+  ASSERT_EQ(olength(l).value.int_v, 5000);
+  int i = 0;
+  long int adjacent = 0;
+  ofor_each(elm, head, l) {
+    ASSERT_EQ(intv(elm), i++);
+    adjacent += oslot(cdr(head)) == oslot(head) - 1 || oslot(cdr(head)) == oslot(head) + 1;
+  }
+  /* only page boundaries break the run */
+  ASSERT(adjacent >= 5000 - 1 - 5000 / (long int)SLAB_PAGE_SLOTS - 2);
+
+  object out[5000];
+  ASSERT_EQ(list_to_array(l, out, 5000), 5000);
+  ASSERT_EQ(intv(&out[4999]), 4999);
+  ASSERT_EQ(list_to_array(l, out, 10), 10);
+  ASSERT_EQ(ofree(l), 5000);
+
+  double doubles[] = { 0.5, 1.5, 2.5 };
+  object* d = list_from_doubles(doubles, 3);
+  ASSERT_EQ(doublev(&car(cdr(d))), 1.5);
+  ASSERT(is(*list_from_ints(ints, 0), nil));
+
+  char text[] = "copied into the list";
+  object xs[] = { make_int(1), make_string(text), make_symbol("sym") };
+  object* x = list_from_objects(xs, 3);
+  ASSERT(stringv(&car(cdr(x))) != text);
+  ASSERT(otruthy(*oequal(&car(cdr(x)), &xs[1])));
+  ASSERT_EQ(list_to_array(x, out, 5), 3);
+
+  oregion(r) {
+    object* local = list_from_ints(ints, 100);
+    ASSERT(opage(local)->region == r);
+    ASSERT_EQ(olength(local).value.int_v, 100);
+  }
+  PASS();
+}
+
+TEST list_compact_test () {
+  int ints[10000];
+  for (int i = 0; i < 10000; i++) {
+    ints[i] = i;
+  }
+  object* l = list_from_ints(ints, 10000);
+  long int runs = compact_runs.count;
+  object* c = ocompact(l);
+  ASSERT(compact_runs.count > runs + 1);
+  ASSERT(ocdr_coded(c));
+  ASSERT((struct general_packed*)cdr(c) == (struct general_packed*)c + 1);
+  ASSERT_EQ(olength(c).value.int_v, 10000);
+  ASSERT(otruthy(*oequal(c, l)));
+  ASSERT_EQ(ohash(c), ohash(l));
+  int i = 0;
+  ofor_each(elm, head, c) {
+    ASSERT_EQ(intv(elm), i++);
+  }
+  object* copy = ocopy(c);
+  ASSERT(!ocdr_coded(copy));
+  ASSERT(otruthy(*oequal(copy, c)));
+  ofree(copy);
+
+  /* a coded cell moves out of its run when its cdr is set */
+  object* third = cdr(cdr(c));
+  ASSERT(ocdr_coded(third));
+  osetcdr(third, list1(make_int(-1)));
+  ASSERT(!ocdr_coded(third));
+  ASSERT_EQ(intv(&car(third)), 2);
+  ASSERT_EQ(olength(c).value.int_v, 4);
+  ASSERT_EQ(intv(&car(cdr(cdr(cdr(c))))), -1);
+  car(third) = make_int(20);
+  ASSERT_EQ(intv(&car(cdr(cdr(c)))), 20);
+
+  char text[] = "copied into the run";
+  object* s = ocompact(list3(make_string(text), make_int(1), *list1(make_int(2))));
+  ASSERT(stringv(&car(s)) != text);
+  ASSERT(!ocdr_coded(cdr(cdr(s))));
+  ASSERT(is(*cdr(cdr(cdr(s))), nil));
+  ASSERT(is(*ocompact(NIL), nil));
+
+  long int left = compact_runs.count;
+  ASSERT_EQ(ofree(s), 3);
+  ASSERT_EQ(compact_runs.count, left - 1);
+  ASSERT_EQ(ofree(l), 10000);
+  PASS();
+}
+
 TEST list_push () {
   object* l1 = list1(make_int(5));
   object* l2 = opush(make_int(33), l1);
@@ -280,6 +547,255 @@ TEST list_pop () {
   PASS();
 }
 
+TEST list_headed_test () {
+  object* h = oheaded(list3(make_int(1), make_int(2), make_int(3)));
+  ASSERT(is(*h, headed));
+  ASSERT_EQ(olength(h).value.int_v, 3);
+  ASSERT(headedv(h)->last == olast(oheaded_list(h)));
+
+  opush(make_int(0), h);
+  oheaded_add(h, make_int(4));
+  oheaded_append(h, list2(make_int(5), make_int(6)));
+  ASSERT_EQ(olength(h).value.int_v, 7);
+  ASSERT_EQ(olength(oheaded_list(h)).value.int_v, 7);
+  ASSERT_EQ(intv(&car(headedv(h)->last)), 6);
+  ASSERT_EQ(oadd(h).value.int_v, 21);
+
+  for (int i = 0; i < 7; i++) {
+    ASSERT_EQ(intv(opop(h)), i);
+    ASSERT_EQ(olength(h).value.int_v, 6 - i);
+  }
+  ASSERT(is(*opop(h), nil));
+  ASSERT(is(*oheaded_list(h), nil));
+  ASSERT(headedv(h)->last == NULL);
+
+  oheaded_add(h, make_string("only element"));
+  opush(make_int(1), h);
+  object* copy = ocopy(h);
+  ASSERT(copy != h);
+  ASSERT(otruthy(*oequal(copy, h)));
+  ASSERT_EQ(ohash(copy), ohash(h));
+  oheaded_add(copy, make_int(2));
+  ASSERT(ofalsy(*oequal(copy, h)));
+
+  object* both = oappend(list2(*h, *copy));
+  ASSERT_EQ(olength(both).value.int_v, 5);
+
+  ASSERT_EQ(ofree(copy), 4);
+  ASSERT_EQ(ofree(h), 3);
+  PASS();
+}
+
+TEST list_atomic_test () {
+  object* h = oheaded(list2(make_int(1), make_int(2)));
+  opush_atomic(make_int(0), h);
+  ASSERT_EQ(olength(h).value.int_v, 3);
+  object v = opop_atomic(h);
+  ASSERT_EQ(intv(&v), 0);
+
+  /* the last cell is found again for adding at the end */
+  oheaded_add(h, make_int(3));
+  ASSERT(otruthy(*oequal(oheaded_list(h), list3(make_int(1), make_int(2), make_int(3)))));
+  ASSERT(headedv(h)->last == olast(oheaded_list(h)));
+  for (int i = 1; i <= 3; i++) {
+    v = opop_atomic(h);
+    ASSERT_EQ(intv(&v), i);
+  }
+  v = opop_atomic(h);
+  ASSERT(is(v, nil));
+  ASSERT_EQ(olength(h).value.int_v, 0);
+
+  opush_atomic(make_string("pushed"), h);
+  v = opop_atomic(h);
+  object expected = make_string("pushed");
+  ASSERT(otruthy(*oequal(&v, &expected)));
+
+  /* popped cells are freed as the epochs move on */
+  long int before = objects_allocated;
+  for (int i = 0; i < 10000; i++) {
+    opush_atomic(make_int(i), h);
+    opop_atomic(h);
+  }
+  ASSERT(objects_allocated - before < 256);
+
+  /* but a region's cells are left to the region */
+  oregion(r) {
+    object* local = oheaded(NIL);
+    opush_atomic(make_int(1), local);
+    opush_atomic(make_int(2), local);
+    v = opop_atomic(local);
+    ASSERT_EQ(intv(&v), 2);
+  }
+  for (int i = 0; i < 1000; i++) {
+    opush_atomic(make_int(i), h);
+    opop_atomic(h);
+  }
+  ogc_collect();
+  PASS();
+}
+
+object parallel_square(object* x) {
+  return make_int(intv(x) * intv(x));
+}
+
+bool parallel_odd(object* x) {
+  return intv(x) % 2;
+}
+
+object parallel_max(object a, object b) {
+  return intv(&a) > intv(&b) ? a : b;
+}
+
+TEST list_parallel_test () {
+  long int n = 3 * PARALLEL_CHUNK + 5;
+  int* xs = malloc(sizeof(int) * n);
+  for (long int i = 0; i < n; i++) {
+    xs[i] = (i * 7919) % 1000;
+  }
+  object* list = list_from_ints(xs, n);
+  object* vec = ovector_from_list(list);
+
+  opool_start(3);
+  long int threshold = parallel_threshold;
+  /* the second pass runs everything on this thread */
+  for (int pass = 0; pass < 2; pass++) {
+    parallel_threshold = pass ? n + 1 : PARALLEL_CHUNK;
+    for (int kind = 0; kind < 2; kind++) {
+      object* o = kind ? vec : list;
+      object* squares = omap(o, parallel_square);
+      object* odds = ofilter(o, parallel_odd);
+      ASSERT(kind ? is(*squares, vector) : is(*squares, cell));
+      ASSERT_EQ(olength(squares).value.int_v, n);
+
+      long int kept = 0;
+      int max = 0, sum = 0;
+      object* square = squares;
+      object* odd = odds;
+      for (long int i = 0; i < n; i++) {
+        object* x = kind ? ovector_ref(squares, i) : square;
+        ASSERT_EQ(intv(kind ? x : &car(x)), xs[i] * xs[i]);
+        if (!kind) {
+          square = cdr(square);
+        }
+        if (xs[i] % 2) {
+          object* y = kind ? ovector_ref(odds, kept) : odd;
+          ASSERT_EQ(intv(kind ? y : &car(y)), xs[i]);
+          if (!kind) {
+            odd = cdr(odd);
+          }
+          kept++;
+        }
+        max = xs[i] > max ? xs[i] : max;
+        sum += xs[i];
+      }
+      ASSERT_EQ(kind ? vectorv(odds)->length : olength(odds).value.int_v, kept);
+
+      object m = oreduce(o, parallel_max, make_int(0));
+      ASSERT_EQ(intv(&m), max);
+      ASSERT_EQ(oadd_parallel(o).value.int_v, sum);
+      ASSERT_EQ(oadd_parallel(o).value.int_v, oadd(o).value.int_v);
+    }
+  }
+  parallel_threshold = threshold;
+
+  object* headed = oheaded(list);
+  ASSERT_EQ(oadd_parallel(headed).value.int_v, oadd(list).value.int_v);
+  ASSERT(is(*omap(NIL, parallel_square), nil));
+  object empty = oreduce(NIL, parallel_max, make_int(-1));
+  ASSERT_EQ(intv(&empty), -1);
+  opool_stop();
+  ASSERT(pool == NULL);
+  free(xs);
+  PASS();
+}
+
+TEST list_share_test () {
+  object* a = list3(make_int(1), make_string("a shared string"), make_int(3));
+  object* b = oshare(a);
+  ASSERT(b != a);
+  ASSERT(cellv(b) == cellv(a));
+  ASSERT(otruthy(*oequal(a, b)));
+  ASSERT(cellv(b) == cellv(a));
+
+  osetcar(b, make_int(10));
+  ASSERT(cellv(b) != cellv(a));
+  ASSERT_EQ(intv(&car(a)), 1);
+  ASSERT_EQ(intv(&car(b)), 10);
+  ASSERT(cellv(cell_next(a)) == cellv(cell_next(b)));
+
+  opush(make_int(0), a);
+  ASSERT_EQ(olength(a).value.int_v, 4);
+  ASSERT_EQ(olength(b).value.int_v, 3);
+  ASSERT_EQ(intv(&car(b)), 10);
+
+  object* c = oshare(b);
+  ASSERT_EQ(intv(opop(c)), 10);
+  ASSERT_EQ(olength(c).value.int_v, 2);
+  ASSERT_EQ(olength(b).value.int_v, 3);
+  ASSERT_EQ(intv(&car(b)), 10);
+  ASSERT(otruthy(*oequal(&car(c), &car(cdr(b)))));
+  ASSERT(stringv(&car(c)) != stringv(&car(cdr(b))));
+
+  copy_on_write = true;
+  object* d = ocopy(a);
+  object* e = cons(*a, NIL);
+  copy_on_write = false;
+  ASSERT(cellv(d) == cellv(a));
+  ASSERT(cellv(&car(e)) == cellv(a));
+  osetcar(&car(e), make_int(-1));
+  ASSERT_EQ(intv(&car(a)), 0);
+  ASSERT_EQ(intv(&car(&car(e))), -1);
+  ASSERT_EQ(intv(&car(d)), 0);
+
+  /* only what isn't shared is freed */
+  ASSERT_EQ(ofree(d), 1);
+  ASSERT_EQ(ofree(e), 1);
+  ofree(c);
+  ASSERT_EQ(olength(b).value.int_v, 3);
+  ofree(b);
+  ASSERT_EQ(olength(a).value.int_v, 4);
+  ASSERT_EQ(intv(&car(olast(a))), 3);
+  PASS();
+}
+
+TEST list_share_deep_test () {
+  copy_on_write = true;
+  object* l = cons(make_int(0), list3(make_int(1), make_int(2), make_int(3)));
+  object* c = ocopy(l);
+  copy_on_write = false;
+
+  /* written two cells down the copy */
+  osetcar(cdr(cdr(c)), make_int(99));
+  ASSERT_EQ(intv(&car(cdr(cdr(c)))), 99);
+  ASSERT_EQ(intv(&car(cdr(cdr(l)))), 2);
+
+  object* c2 = oshare(l);
+  ASSERT_EQ(intv(opop(cdr(c2))), 1);
+  ASSERT_EQ(olength(c2).value.int_v, 3);
+  ASSERT_EQ(olength(l).value.int_v, 4);
+  ASSERT_EQ(intv(&car(cdr(l))), 1);
+  opush(make_int(5), cdr(cdr(c2)));
+  osetcdr(cdr(c2), NIL);
+  ASSERT_EQ(olength(c2).value.int_v, 2);
+  ASSERT_EQ(olength(l).value.int_v, 4);
+
+  /* and the other way round */
+  osetcar(cdr(cdr(cdr(l))), make_int(7));
+  ASSERT_EQ(intv(&car(olast(c))), 3);
+  ASSERT_EQ(intv(&car(olast(l))), 7);
+  ASSERT_EQ(intv(&car(cdr(cdr(c)))), 99);
+
+  /* a handle taken before the share */
+  object* m = list3(make_int(1), make_int(2), make_int(3));
+  object* second = cdr(m);
+  object* s = oshare(m);
+  osetcar(second, make_int(42));
+  osetcdr(second, NIL);
+  ASSERT_EQ(intv(&car(cdr(s))), 2);
+  ASSERT_EQ(olength(s).value.int_v, 3);
+  PASS();
+}
+
 TEST list_last() {
   object* l3 = list3(make_int(3), make_int(4), make_int(5));
   object* l3last = olast(l3);
@@ -373,6 +889,176 @@ TEST object_copy() {
   PASS();
 }
 
+struct copy_reader {
+  object* list;
+  bool done;
+  long int bad;
+};
+
+/**
+ * Count the cars of r->list that aren't lists until r->done is set.
+ */
+void* copy_reader(void* arg) {
+  struct copy_reader* r = arg;
+  do {
+    for (object* o = r->list; is(*o, cell); o = cdr(o)) {
+      r->bad += !is(car(o), cell);
+    }
+  } while (!__atomic_load_n(&r->done, __ATOMIC_ACQUIRE));
+  return NULL;
+}
+
+TEST object_copy_deep() {
+  /* long enough to run out of stack if copying recursed */
+  int n = 1000000;
+  int* xs = malloc(sizeof(int) * n);
+  for (int i = 0; i < n; i++) {
+    xs[i] = i;
+  }
+  object* big = list_from_ints(xs, n);
+  free(xs);
+  object* copy = ocopy(big);
+  ASSERT_EQ(olength(copy).value.int_v, n);
+  ASSERT_EQ(ofree(copy), n);
+  copy = ocopy_deep(big);
+  ASSERT(otruthy(*oequal(copy, big)));
+  ASSERT_EQ(ofree(copy), n);
+  ofree(big);
+
+  /* shared cars stay shared, strings are copied */
+  object* inner = list2(make_string("inner string value"), make_int(2));
+  object* outer = list3(*inner, make_int(0), *inner);
+  setcellv(&car(olast(outer)), cellv(inner));
+  ASSERT(cellv(&car(outer)) != cellv(inner));
+  setcellv(&car(outer), cellv(inner));
+  object* deep = ocopy_deep(outer);
+  ASSERT(otruthy(*oequal(deep, outer)));
+  ASSERT(cellv(&car(deep)) == cellv(&car(olast(deep))));
+  ASSERT(cellv(&car(deep)) != cellv(inner));
+  ASSERT(stringv(&car(&car(deep))) != stringv(&car(inner)));
+
+  /* a cycle comes out as the same cycle */
+  object* ring = list3(make_int(1), make_int(2), make_int(3));
+  osetcdr(olast(ring), ring);
+  object* ring_copy = ocopy_deep(ring);
+  ASSERT(ring_copy != ring);
+  ASSERT_EQ(intv(&car(ring_copy)), 1);
+  ASSERT(cdr(cdr(cdr(ring_copy))) == ring_copy);
+  ASSERT(cdr(cdr(cdr(ring))) == ring);
+
+  /* improper tails and compact lists */
+  object tail = make_string("a long dotted tail");
+  object* dotted = cons(make_int(1), ocopy(&tail));
+  object* dotted_copy = ocopy_deep(dotted);
+  ASSERT(cdr(dotted_copy) != cdr(dotted));
+  ASSERT(otruthy(*oequal(dotted_copy, dotted)));
+  object* packed = ocompact(list3(make_int(1), make_int(2), make_int(3)));
+  ASSERT(otruthy(*oequal(ocopy_deep(packed), packed)));
+
+  /* the list is only read, another thread can read it meanwhile */
+  object* nested = NIL;
+  for (int i = 0; i < 100000; i++) {
+    nested = cons(*list2(make_int(i), make_int(0)), nested);
+  }
+  ogc_root(nested);
+  struct copy_reader reader = { nested, false, 0 };
+  pthread_t thread;
+  pthread_create(&thread, NULL, copy_reader, &reader);
+  for (int i = 0; i < 10; i++) {
+    ocopy_deep(nested);
+  }
+  __atomic_store_n(&reader.done, true, __ATOMIC_RELEASE);
+  pthread_join(thread, NULL);
+  ASSERT_EQ(reader.bad, 0);
+  ogc_unroot(nested);
+  PASS();
+}
+
+/**
+ * Lists width long nested depth deep, ints and strings at the bottom.
+ */
+object* parallel_tree(int width, int depth, int* leaves) {
+  object* list = NIL;
+  for (int i = 0; i < width; i++) {
+    if (depth > 1) {
+      list = cons(*parallel_tree(width, depth - 1, leaves), list);
+    } else if (++*leaves % 5) {
+      list = cons(make_int(*leaves), list);
+    } else {
+      list = cons(make_string("a leaf string kept on the heap"), list);
+    }
+  }
+  return list;
+}
+
+TEST object_parallel_test() {
+  opool_start(3);
+  int leaves = 0;
+  object* tree = parallel_tree(6, 6, &leaves);
+  object* shared = list2(make_int(7), make_string("a string in a shared list"));
+  osetcar(tree, *shared);
+  osetcar(cdr(tree), *shared);
+  object* copy = ocopy_deep_parallel(tree);
+  ASSERT(otruthy(*oequal(copy, tree)));
+  ASSERT(otruthy(*oequal(copy, ocopy_deep(tree))));
+  ASSERT(otruthy(*oequal_parallel(copy, tree)));
+  ASSERT(cellv(&car(copy)) == cellv(&car(cdr(copy))));
+  ASSERT(cellv(&car(copy)) != cellv(shared));
+  ASSERT(stringv(&car(cdr(&car(copy)))) != stringv(&car(cdr(shared))));
+  ASSERT(cellv(&car(olast(copy))) != cellv(&car(olast(tree))));
+
+  /* a difference at the bottom of the last subtree */
+  object* bottom = olast(copy);
+  while (is(car(bottom), cell)) {
+    bottom = olast(&car(bottom));
+  }
+  osetcar(bottom, make_int(-1));
+  ASSERT(ofalsy(*oequal(copy, tree)));
+  ASSERT(ofalsy(*oequal_parallel(copy, tree)));
+  ASSERT(ofalsy(*oequal_parallel(tree, copy)));
+
+  /* a cycle comes out as the same cycle */
+  object* ring = list3(make_int(1), make_int(2), make_int(3));
+  osetcdr(olast(ring), ring);
+  object* ring_copy = ocopy_deep_parallel(ring);
+  ASSERT(ring_copy != ring);
+  ASSERT_EQ(intv(&car(ring_copy)), 1);
+  ASSERT(cdr(cdr(cdr(ring_copy))) == ring_copy);
+  ASSERT(cdr(cdr(cdr(ring))) == ring);
+
+  /* improper tails and compact lists */
+  object tail = make_string("a long dotted tail");
+  object* dotted = cons(make_int(1), ocopy(&tail));
+  object* dotted_copy = ocopy_deep_parallel(dotted);
+  ASSERT(cdr(dotted_copy) != cdr(dotted));
+  ASSERT(otruthy(*oequal(dotted_copy, dotted)));
+  object* packed = ocompact(list3(*tree, make_int(2), make_int(3)));
+  ASSERT(otruthy(*oequal_parallel(ocopy_deep_parallel(packed), packed)));
+
+  /* cars that are the numbers handed out, read while copied */
+  object* numbered = NIL;
+  for (int i = 0; i < 20000; i++) {
+    numbered = cons(*list2(make_int(i % 300), make_int(i)), numbered);
+  }
+  ogc_root(numbered);
+  struct copy_reader reader = { numbered, false, 0 };
+  pthread_t thread;
+  pthread_create(&thread, NULL, copy_reader, &reader);
+  for (int i = 0; i < 10; i++) {
+    ASSERT(otruthy(*oequal(ocopy_deep_parallel(numbered), numbered)));
+  }
+  __atomic_store_n(&reader.done, true, __ATOMIC_RELEASE);
+  pthread_join(thread, NULL);
+  ASSERT_EQ(reader.bad, 0);
+  ASSERT_EQ(intv(&car(&car(numbered))), 19999 % 300);
+  ogc_unroot(numbered);
+
+  /* without a pool the serial ones run */
+  opool_stop();
+  ASSERT(otruthy(*oequal_parallel(ocopy_deep_parallel(tree), tree)));
+  PASS();
+}
+
 TEST object_equal() {
   object a = make_double(3.0);
   object b = make_int(4.0);
@@ -380,7 +1066,7 @@ TEST object_equal() {
   object* d = list3(a, b, c);
   ofor_each(elm, head, d) {
     ofor_each(elm2, head2, d) {
-      if (elm->tag != elm2->tag) {
+      if (otag(*elm) != otag(*elm2)) {
         ASSERT(ofalsy(*oequal(elm, elm2)));
       }
     }
@@ -415,6 +1101,92 @@ TEST object_equal() {
   PASS();
 }
 
+TEST hash_test () {
+  object i = make_int(3);
+  object d = make_double(3.0);
+  object h = make_double(3.5);
+  ASSERT_EQ(ohash(&i), ohash(&d));
+  ASSERT(ohash(&i) != ohash(&h));
+  object zero = make_double(0.0);
+  object negative_zero = make_double(-0.0);
+  ASSERT_EQ(ohash(&zero), ohash(&negative_zero));
+
+  object s = make_string("a string that is not small");
+  object y = make_symbol("a string that is not small");
+  object* copy = ocopy(&s);
+  ASSERT_EQ(ohash(&s), ohash(&y));
+  ASSERT_EQ(ohash(&s), ohash(copy));
+
+  object* a = list3(make_int(1), make_string("b"), *list2(make_double(2.0), s));
+  object* b = list3(make_double(1.0), make_symbol("b"), *list2(make_int(2), y));
+  ASSERT(otruthy(*oequal(a, b)));
+  ASSERT_EQ(ohash(a), ohash(b));
+  object* c = list3(make_int(1), make_string("b"), *list2(make_int(3), s));
+  ASSERT(ohash(a) != ohash(c));
+  ASSERT(ohash(a) != ohash(cdr(a)));
+
+  object* v = ovector_from_list(a);
+  object* w = ovector_from_list(b);
+  ASSERT_EQ(ohash(v), ohash(w));
+  ASSERT(ohash(v) != ohash(a));
+
+  object* ints = oarray_from(list2(make_int(1), make_int(2)));
+  object* doubles = oarray_from(list2(make_int(1), make_double(2.5)));
+  object* ints2 = oarray_from(list2(make_int(1), make_int(2)));
+  ASSERT_EQ(ohash(ints), ohash(ints2));
+  ASSERT(ohash(ints) != ohash(doubles));
+
+  long int length = 100000;
+  object* l = NIL;
+  for (int k = 0; k < length; k++) {
+    l = cons(make_int(k), l);
+  }
+  ASSERT(ohash(l) != ohash(cdr(l)));
+  ofree(l);
+  PASS();
+}
+
+TEST symbol_test () {
+  char a[] = "key";
+  char b[] = "key";
+  ASSERT(ointern(a) == ointern(b));
+  ASSERT(ointern(a) != a);
+  ASSERT(ointern("key") != ointern("other"));
+  ASSERT_STR_EQ(ointern(a), "key");
+
+  object x = make_symbol(a);
+  object y = make_symbol(b);
+  ASSERT(is(x, symbol));
+  ASSERT(symbolv(&x) == symbolv(&y));
+  ASSERT(otruthy(*oequal(&x, &y)));
+  object z = make_symbol("other");
+  ASSERT(ofalsy(*oequal(&x, &z)));
+  object s = make_string("key");
+  ASSERT(otruthy(*oequal(&x, &s)));
+
+  long int strings = owned_strings.count;
+  object* l = list2(make_symbol("k1"), make_symbol("k2"));
+  ASSERT_EQ(owned_strings.count, strings);
+  ASSERT(symbolv(&car(l)) == ointern("k1"));
+  ASSERT(otruthy(*oequal(ocopy(l), list2(make_symbol("k1"), make_symbol("k2")))));
+  ASSERT_EQ(ofree(l), 2);
+
+  long int interned = intern_table.count;
+  for (int i = 0; i < 1000; i++) {
+    char key[16];
+    sprintf(key, "key%d", i % 10);
+    ointern(key);
+  }
+  ASSERT_EQ(intern_table.count, interned + 10);
+
+  intern_strings = true;
+  object t = make_string("key");
+  intern_strings = false;
+  ASSERT(is(t, symbol));
+  ASSERT(symbolv(&t) == symbolv(&x));
+  PASS();
+}
+
 TEST string_equal () {
   object s0 = make_string("Hello");
   object s1 = make_string("Goodbye");
@@ -425,7 +1197,8 @@ TEST string_equal () {
   ASSERT(is(*ostring_equal(&s2, &s0), t));
   ASSERT(is(*ostring_equal(&s2, &s2), t));
 
-  stringv(&s2) = stringv(&s2) + 1;
+  char hello[] = "Hello";
+  setstringv(&s2, hello + 1);
 
   ASSERT(is(*ostring_equal(&s0, &s2), nil));
   ASSERT(is(*ostring_equal(&s2, &s0), nil));
@@ -433,18 +1206,56 @@ TEST string_equal () {
   PASS();
 }
 
+TEST string_test () {
+  long int strings = owned_strings.count;
+  object small = make_string("abc");
+  object empty = make_string("");
+  ASSERT_EQ(ostring_form(&small), STRING_SMALL);
+  ASSERT_EQ(owned_strings.count, strings);
+  ASSERT_EQ(ostring_length(&small), 3);
+  ASSERT_EQ(ostring_length(&empty), 0);
+  ASSERT(strcmp(stringv(&small), "abc") == 0);
+
+  string text = "a string too long to be inline";
+  object raw = make_string(text);
+  ASSERT_EQ(ostring_form(&raw), STRING_RAW);
+  ASSERT(stringv(&raw) == text);
+  ASSERT_EQ(owned_strings.count, strings);
+
+  object heap = string_copy(&raw);
+  ASSERT_EQ(ostring_form(&heap), STRING_HEAP);
+  ASSERT(stringv(&heap) != text);
+  ASSERT_EQ(ostring_length(&heap), (long int)strlen(text));
+  ASSERT_EQ(owned_strings.count, strings + 1);
+  ASSERT_EQ(ostring_hash(&raw), ostring_hash(&heap));
+  ASSERT(otruthy(*ostring_equal(&raw, &heap)));
+  ASSERT(ostring_hash(&small) != ostring_hash(&heap));
+
+  object* l = list2(small, heap);
+  ASSERT_EQ(ostring_form(&car(l)), STRING_SMALL);
+  ASSERT(stringv(&car(cdr(l))) != stringv(&heap));
+  ASSERT_EQ(ostring_length(&car(cdr(l))), ostring_length(&heap));
+  object* copy = ocopy(l);
+  ASSERT(otruthy(*oequal(copy, l)));
+  ofree(copy);
+  ofree(l);
+  ostring_free(stringv(&heap));
+  ASSERT_EQ(owned_strings.count, strings);
+  PASS();
+}
+
 TEST oalloc_test () {
   object* a = oalloc();
   ASSERT(sizeof(a) == sizeof(object*));
   ASSERT(sizeof(*a) == sizeof(object));
-  ASSERT(a->tag == 0);
+  ASSERT(otag(*a) == 0);
   ASSERT(is(*a, int));
   ASSERT(!is(*a, double));
   ASSERT(intv(a) == 0);
 
   long int current_allocs = objects_allocated;
   list4(make_int(3), make_int(5), make_int(2), make_double(1));
-  ASSERT_EQ(current_allocs + 8, objects_allocated);
+  ASSERT_EQ(current_allocs + 4, objects_allocated);
   
   PASS();
 }
@@ -460,6 +1271,1279 @@ TEST ofree_test () {
   PASS();
 }
 
+TEST slab_test () {
+  object* l = list2(make_int(1), make_int(2));
+  ASSERT(cellv(l) == &oslot(l)->cell);
+  ASSERT(cellv(cdr(l)) == &oslot(cdr(l))->cell);
+
+  object* a = oalloc();
+  ASSERT(ofree(a) == 1);
+  object* b = oalloc();
+  ASSERT(a == b);
+  ASSERT(is(*b, int));
+  ASSERT(intv(b) == 0);
+
+  object* big = NIL;
+  for (int i = 0; i < (int)SLAB_PAGE_SLOTS * 3; i++) {
+    big = cons(make_int(i), big);
+  }
+  ASSERT(olength(big).value.int_v == SLAB_PAGE_SLOTS * 3);
+  ASSERT(intv(&car(big)) == SLAB_PAGE_SLOTS * 3 - 1);
+  ASSERT(ofree(big) == SLAB_PAGE_SLOTS * 3);
+  PASS();
+}
+
+TEST region_test () {
+  long int current_allocs = objects_allocated;
+  object* kept = NULL;
+  struct general_region* r = oregion_begin();
+  ASSERT(current_region == r);
+
+  object* l = list3(make_int(1), make_string("two"), make_double(3));
+  l = cons(*list2(make_string("nested"), make_int(4)), l);
+  ASSERT(opage(l)->region == r);
+  ASSERT(opage(cellv(&car(l)))->region == r);
+  ASSERT(ofree(l) == 0);
+  ASSERT_EQ(current_allocs, objects_allocated);
+
+  kept = opromote(l);
+  ASSERT(opage(kept)->region == NULL);
+  ASSERT(opage(cellv(&car(kept)))->region == NULL);
+  ASSERT(otruthy(*oequal(kept, l)));
+  oregion_end(r);
+  ASSERT(current_region == NULL);
+
+  ASSERT(olength(kept).value.int_v == 4);
+  ASSERT(intv(&cadr(kept)) == 1);
+  object two = make_string("two");
+  ASSERT(otruthy(*ostring_equal(&caddr(kept), &two)));
+  object nested = make_string("nested");
+  ASSERT(otruthy(*ostring_equal(&car(&car(kept)), &nested)));
+
+  object* outer = NULL;
+  oregion(a) {
+    object* x = list1(make_int(5));
+    oregion(b) {
+      ASSERT(current_region == b);
+      ASSERT(b->parent == a);
+      object* y = list1(make_string("inner"));
+      outer = opromote(y);
+      ASSERT(opage(outer)->region == a);
+    }
+    ASSERT(current_region == a);
+    ASSERT(intv(&car(x)) == 5);
+    outer = opromote(outer);
+  }
+  ASSERT(current_region == NULL);
+  ASSERT(opage(outer)->region == NULL);
+  object inner = make_string("inner");
+  ASSERT(otruthy(*ostring_equal(&car(outer), &inner)));
+  ASSERT(ofree(outer) == 1);
+  PASS();
+}
+
+TEST registry_test () {
+  object* objects[200];
+  for (int i = 0; i < 200; i++) {
+    objects[i] = oalloc();
+  }
+  for (long int i = 0; i < objects_allocated; i++) {
+    object* o = allocated_objects[i];
+    ASSERT_EQ(opage(o)->index[oslot_index(o)], i);
+  }
+  long int current_allocs = objects_allocated;
+  for (int i = 0; i < 200; i += 2) {
+    ofree(objects[i]);
+  }
+  ASSERT_EQ(current_allocs - 100, objects_allocated);
+  for (long int i = 0; i < objects_allocated; i++) {
+    object* o = allocated_objects[i];
+    ASSERT_EQ(opage(o)->index[oslot_index(o)], i);
+  }
+  PASS();
+}
+
+TEST refs_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  long int before = objects_allocated;
+  object* l = list3(make_int(1), make_string("counted"), make_int(3));
+  ASSERT_EQ(orefs(l), 0);
+  ASSERT(oretain(l) == l);
+  oretain(l);
+  ASSERT_EQ(orefs(l), 2);
+
+  /* counted objects are kept by the collector */
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, before + 3);
+  orelease(l);
+  ASSERT_EQ(orefs(l), 1);
+  ASSERT_EQ(objects_allocated, before + 3);
+  orelease(l);
+  ASSERT_EQ(objects_allocated, before);
+
+  /* a counted tail outlives its list */
+  l = list3(make_int(1), make_int(2), make_int(3));
+  object* tail = oretain(cdr(l));
+  ASSERT_EQ(ofree(l), 1);
+  ASSERT_EQ(intv(&car(tail)), 2);
+  orelease(tail);
+  ASSERT_EQ(objects_allocated, before);
+
+  /* region objects and statics aren't counted */
+  oregion(r) {
+    object* local = list1(make_int(1));
+    oretain(local);
+    ASSERT_EQ(orefs(local), 0);
+    orelease(local);
+  }
+  oretain(NIL);
+  ASSERT_EQ(orefs(NIL), 0);
+  orelease(NIL);
+  object* outside = malloc(sizeof(object));
+  *outside = make_int(5);
+  ASSERT(oretain(outside) == outside);
+  ASSERT_EQ(orefs(outside), 0);
+  ASSERT(oatomic(outside) == outside);
+  orelease(outside);
+  ASSERT_EQ(intv(outside), 5);
+  free(outside);
+  object on_stack = make_int(6);
+  oretain(&on_stack);
+  ASSERT_EQ(orefs(&on_stack), 0);
+  orelease(&on_stack);
+
+  /* a cell off the slab in a list is skipped over when it's freed */
+  cell* spliced = malloc(sizeof(cell));
+  spliced->car = make_int(2);
+  spliced->cdr = list1(make_int(3));
+  object* middle = malloc(sizeof(object));
+  *middle = make_cell(spliced);
+  l = list1(make_int(1));
+  osetcdr(l, middle);
+  ASSERT_EQ(ofree(l), 2);
+  ASSERT_EQ(objects_allocated, before);
+  free(spliced);
+  free(middle);
+
+  /* atomic counts keep working on the allocating thread */
+  object* a = oatomic(list1(make_int(7)));
+  ASSERT_EQ(orefs(a), 1);
+  oretain(a);
+  orelease(a);
+  ASSERT_EQ(orefs(a), 1);
+  orelease(a);
+  ASSERT_EQ(objects_allocated, before);
+  gc_scan_stack = true;
+  PASS();
+}
+
+void* refs_worker(void* arg) {
+  object* o = arg;
+  for (int i = 0; i < 100000; i++) {
+    oretain(o);
+    orelease(o);
+  }
+  orelease(o);
+  return NULL;
+}
+
+TEST refs_thread_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  long int before = objects_allocated;
+  object* shared = oatomic(list2(make_string("shared"), make_int(2)));
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++) {
+    oretain(shared);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_create(&threads[i], NULL, refs_worker, shared);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  ASSERT_EQ(orefs(shared), 1);
+
+  /* the last reference dropped on another thread */
+  pthread_create(&threads[0], NULL, refs_worker, shared);
+  pthread_join(threads[0], NULL);
+  ASSERT_EQ(objects_allocated, before + 2);
+  ASSERT_EQ(ofree_released(), 2);
+  ASSERT_EQ(objects_allocated, before);
+  ASSERT_EQ(ofree_released(), 0);
+  gc_scan_stack = true;
+  PASS();
+}
+
+struct heap_job {
+  int n;
+  long int sum;
+  object* kept;
+};
+
+void* heap_worker(void* arg) {
+  struct heap_job* job = arg;
+  object* l = NIL;
+  for (int i = 0; i < job->n; i++) {
+    l = cons(make_int(i), l);
+  }
+  job->sum = 0;
+  for (object* c = l; is(*c, cell); c = cdr(c)) {
+    job->sum += intv(&car(c));
+  }
+  ofree(l);
+  job->kept = list2(make_int(job->n), make_string("kept by another thread"));
+  return NULL;
+}
+
+long int heaps_length() {
+  long int n = 0;
+  for (struct general_heap* h = heaps; h; h = h->next) {
+    n++;
+  }
+  return n;
+}
+
+void* share_worker(void* arg) {
+  for (int i = 0; i < 20000; i++) {
+    object* l = list3(make_int(i), make_int(1), make_int(2));
+    object* shared = oshare(l);
+    ofree(shared);
+    ofree(l);
+    ofree(ocompact(list3(make_int(i), make_int(1), make_int(2))));
+  }
+  return NULL;
+}
+
+/**
+ * Entries in a set, counted the long way.
+ */
+long int ptrset_entries(struct general_ptrset* set) {
+  long int n = 0;
+  for (long int i = 0; i < set->size; i++) {
+    n += set->keys[i] != NULL;
+  }
+  return n;
+}
+
+TEST share_thread_test () {
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++) {
+    pthread_create(&threads[i], NULL, share_worker, NULL);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  ASSERT_EQ(ptrset_entries(&shared_cells), shared_cells.count);
+  ASSERT_EQ(ptrset_entries(&compact_runs), compact_runs.count);
+  PASS();
+}
+
+TEST heap_thread_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  long int before = objects_allocated;
+  struct heap_job jobs[4];
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++) {
+    jobs[i] = (struct heap_job){ 10000 * (i + 1), 0, NULL };
+    pthread_create(&threads[i], NULL, heap_worker, &jobs[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  object* kept[4];
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(jobs[i].sum, (long int)jobs[i].n * (jobs[i].n - 1) / 2);
+    ASSERT(opage(jobs[i].kept)->heap != oheap());
+    kept[i] = jobs[i].kept;
+  }
+  ASSERT_EQ(objects_allocated, before);
+
+  /* the next threads adopt the heaps the last ones left, one at a
+     time so none of them runs short */
+  long int count = heaps_length();
+  for (int i = 0; i < 4; i++) {
+    pthread_create(&threads[i], NULL, heap_worker, &jobs[i]);
+    pthread_join(threads[i], NULL);
+  }
+  ASSERT_EQ(heaps_length(), count);
+
+  /* slots freed here go back to the heap they came from */
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(ofree(kept[i]), 2);
+    ASSERT_EQ(intv(&car(jobs[i].kept)), jobs[i].n);
+  }
+  ASSERT_EQ(objects_allocated, before);
+  ogc_collect();
+  for (struct general_heap* h = heaps; h; h = h->next) {
+    if (h != oheap()) {
+      ASSERT_EQ(h->count, 0);
+      ASSERT_EQ(h->strings.count, 0);
+    }
+  }
+  gc_scan_stack = true;
+  PASS();
+}
+
+#define STACK_ITEMS 20000
+
+struct stack_job {
+  object* stack;
+  int id;
+  long int* remaining;
+  unsigned char* seen;
+};
+
+void* stack_producer(void* arg) {
+  struct stack_job* job = arg;
+  for (int i = 0; i < STACK_ITEMS; i++) {
+    opush_atomic(make_int(job->id * STACK_ITEMS + i), job->stack);
+  }
+  return NULL;
+}
+
+void* stack_consumer(void* arg) {
+  struct stack_job* job = arg;
+  while (__atomic_load_n(job->remaining, __ATOMIC_RELAXED) > 0) {
+    object v = opop_atomic(job->stack);
+    if (is(v, int)) {
+      __atomic_add_fetch(&job->seen[intv(&v)], 1, __ATOMIC_RELAXED);
+      __atomic_sub_fetch(job->remaining, 1, __ATOMIC_RELAXED);
+    }
+  }
+  return NULL;
+}
+
+TEST stack_thread_test () {
+  gc_scan_stack = false;
+  object* stack = oheaded(NIL);
+  ogc_root(stack);
+  long int remaining = 4 * STACK_ITEMS;
+  unsigned char* seen = calloc(4 * STACK_ITEMS, 1);
+  struct stack_job jobs[8];
+  pthread_t threads[8];
+  for (int i = 0; i < 8; i++) {
+    jobs[i] = (struct stack_job){ stack, i % 4, &remaining, seen };
+    pthread_create(&threads[i], NULL, i < 4 ? stack_producer : stack_consumer, &jobs[i]);
+  }
+  for (int i = 0; i < 8; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  /* every item popped once */
+  ASSERT_EQ(remaining, 0);
+  for (int i = 0; i < 4 * STACK_ITEMS; i++) {
+    ASSERT_EQ(seen[i], 1);
+  }
+  ASSERT_EQ(olength(stack).value.int_v, 0);
+  ASSERT(is(*oheaded_list(stack), nil));
+  free(seen);
+  ogc_unroot(stack);
+  ogc_collect();
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST gc_collect_test () {
+  gc_scan_stack = false;
+  object* kept = list3(make_int(1), make_string("two"), *list2(make_string("three"), make_int(4)));
+  ogc_root(kept);
+
+  object* garbage = list4(make_string("a"), make_int(1), make_int(2), make_int(3));
+  object* cycle = list2(make_int(1), make_int(2));
+  osetcdr(cdr(cycle), cycle);
+  garbage += 0;
+
+  ASSERT(ogc_collect() > 0);
+  /* kept is three cells, plus the copied nested list */
+  ASSERT_EQ(objects_allocated, 5);
+  ASSERT(intv(&car(kept)) == 1);
+  object two = make_string("two");
+  ASSERT(otruthy(*ostring_equal(&cadr(kept), &two)));
+  object three = make_string("three");
+  ASSERT(otruthy(*ostring_equal(&car(&caddr(kept)), &three)));
+  ASSERT(intv(&cadr(&caddr(kept))) == 4);
+
+  oregion(r) {
+    object* local = cons(make_int(0), kept);
+    ogc_unroot(kept);
+    ogc_root(local);
+    ASSERT_EQ(ogc_collect(), 0);
+    ASSERT_EQ(ogc_collect(), 0);
+    ASSERT_EQ(objects_allocated, 5);
+    ogc_unroot(local);
+  }
+
+  ASSERT_EQ(ogc_collect(), 5);
+  ASSERT_EQ(objects_allocated, 0);
+  ASSERT_EQ(owned_strings.count, 0);
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST gc_threshold_test () {
+  ogc_enable(1000);
+  object* list = NIL;
+  for (int i = 0; i < 10000; i++) {
+    list = cons(make_int(i), list);
+    list4(make_int(1), make_int(2), make_int(3), make_int(4));
+  }
+  ASSERT(objects_allocated < 10000 + 2000);
+
+  long int sum = 0;
+  ofor_each(elm, head, list) {
+    sum += intv(elm);
+  }
+  ASSERT_EQ(sum, 10000L * 9999 / 2);
+  ASSERT_EQ(olength(list).value.int_v, 10000);
+
+  gc_threshold = 0;
+  gc_stack_base = NULL;
+  PASS();
+}
+
+TEST gc_incremental_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  object* kept = NIL;
+  for (int i = 0; i < 1000; i++) {
+    kept = cons(make_int(i), kept);
+  }
+  ogc_root(kept);
+  long int live = objects_allocated;
+  for (int i = 0; i < 500; i++) {
+    list1(make_string("garbage"));
+  }
+  long int garbage = objects_allocated - live;
+
+  gc_step_work = 10;
+  long int steps = 0;
+  long int freed = ogc_step();
+  ASSERT(gc_phase == GC_MARK);
+  while (gc_phase != GC_IDLE) {
+    freed += ogc_step();
+    steps++;
+  }
+  ASSERT(steps > 100);
+  ASSERT_EQ(freed, garbage);
+  ASSERT_EQ(objects_allocated, 1000);
+  ASSERT_EQ(olength(kept).value.int_v, 1000);
+  ASSERT_EQ(owned_strings.count, 0);
+
+  ogc_unroot(kept);
+  ASSERT_EQ(ogc_collect(), 1000);
+  gc_step_work = 1000;
+  gc_scan_stack = true;
+  PASS();
+}
+
+/**
+ * Allocate garbage on a heap of its own and leave a list of it in
+ * arg's car.
+ */
+void* gc_cycle_worker(void* arg) {
+  for (int i = 0; i < 200; i++) {
+    list1(make_string("a worker string"));
+  }
+  osetcar(arg, *list1(make_string("a worker string")));
+  return NULL;
+}
+
+TEST gc_thread_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  object* kept = NIL;
+  for (int i = 0; i < 1000; i++) {
+    kept = cons(make_int(i), kept);
+  }
+  ogc_root(kept);
+  long int live = objects_allocated;
+  for (int i = 0; i < 500; i++) {
+    list1(make_string("garbage"));
+  }
+
+  /* a thread taking a heap mid-cycle abandons it */
+  gc_step_work = 10;
+  long int cycles = gc_stats.cycles;
+  ogc_step();
+  ASSERT(gc_phase == GC_MARK);
+  pthread_t thread;
+  pthread_create(&thread, NULL, gc_cycle_worker, kept);
+  pthread_join(thread, NULL);
+  ASSERT(gc_phase == GC_IDLE);
+  ASSERT_EQ(gc_stats.cycles, cycles);
+
+  /* what it marked doesn't keep the next one from tracing */
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, live);
+  ASSERT_EQ(olength(kept).value.int_v, 1000);
+  ASSERT_STR_EQ(stringv(&car(&car(kept))), "a worker string");
+  /* the worker's cell goes too, from the heap it left behind */
+  ogc_unroot(kept);
+  ASSERT_EQ(ogc_collect(), 1001);
+  gc_step_work = 1000;
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST gc_barrier_test () {
+  gc_scan_stack = false;
+  object* root = list2(make_int(1), make_int(2));
+  ogc_root(root);
+
+  gc_step_work = 1;
+  ogc_step();
+  while (!(opage(root)->flags[oslot_index(root)] & SLOT_MARK_CELL)) {
+    ogc_step();
+  }
+  ASSERT(gc_phase == GC_MARK);
+
+  /* only reachable through stores made after root was traced */
+  osetcdr(cdr(root), list2(make_string("late"), make_int(4)));
+  opush(make_string("pushed"), root);
+  osetcar(cdr(root), *list1(make_int(5)));
+
+  gc_step_work = 1000;
+  while (gc_phase != GC_IDLE) {
+    ogc_step();
+  }
+
+  ASSERT_EQ(olength(root).value.int_v, 5);
+  object late = make_string("late");
+  object pushed = make_string("pushed");
+  ASSERT(otruthy(*ostring_equal(&car(root), &pushed)));
+  ASSERT(intv(&car(&cadr(root))) == 5);
+  ASSERT(otruthy(*ostring_equal(&cadddr(root), &late)));
+  ASSERT_EQ(ogc_collect(), 0);
+
+  ogc_unroot(root);
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 0);
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST gc_sweep_alloc_test () {
+  gc_scan_stack = false;
+  object* root = NIL;
+  for (int i = 0; i < 100; i++) {
+    root = cons(make_int(i), root);
+    list1(make_int(i));
+  }
+  ogc_root(root);
+
+  gc_step_work = 5;
+  while (gc_phase != GC_SWEEP) {
+    ogc_step();
+  }
+  object* during = list3(make_int(1), make_string("during"), make_int(3));
+  ogc_root(during);
+  ofree(opop(root));
+  while (gc_phase != GC_IDLE) {
+    ogc_step();
+  }
+  for (long int i = 0; i < objects_allocated; i++) {
+    object* o = allocated_objects[i];
+    ASSERT_EQ(opage(o)->index[oslot_index(o)], i);
+  }
+  object s = make_string("during");
+  ASSERT(otruthy(*ostring_equal(&cadr(during), &s)));
+  ASSERT_EQ(olength(root).value.int_v, 99);
+
+  ogc_unroot(root);
+  ogc_unroot(during);
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 0);
+  gc_step_work = 1000;
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST gc_stats_test () {
+  long int pauses = gc_stats.pauses;
+  gc_incremental = true;
+  ogc_enable(100);
+  object* list = NIL;
+  for (int i = 0; i < 5000; i++) {
+    list = cons(make_int(i), list);
+  }
+  ASSERT(gc_stats.pauses > pauses);
+  ASSERT(gc_stats.cycles > 0);
+  ASSERT(ogc_pause_percentile(0.99) > 0);
+  ASSERT(ogc_pause_percentile(0.5) <= ogc_pause_percentile(0.99));
+  ASSERT(ogc_pause_percentile(1) <= 2 * gc_stats.max_ns);
+  ASSERT_EQ(olength(list).value.int_v, 5000);
+
+  gc_incremental = false;
+  gc_threshold = 0;
+  gc_stack_base = NULL;
+  ogc_collect();
+  PASS();
+}
+
+TEST representation_test () {
+#ifdef GENERAL_NANBOX
+  ASSERT_EQ(sizeof(object), 8);
+  ASSERT_EQ(sizeof(cell), 16);
+  ASSERT_EQ(sizeof(struct general_slot), 24);
+#endif
+  int ints[] = { 0, 1, -1, 7, INT_MAX, INT_MIN };
+  for (int i = 0; i < 6; i++) {
+    object o = make_int(ints[i]);
+    ASSERT(is(o, int));
+    ASSERT_EQ(intv(&o), ints[i]);
+    intv(&o) = -ints[i] - 1;
+    ASSERT(is(o, int));
+    ASSERT_EQ(intv(&o), -ints[i] - 1);
+  }
+
+  double zero = 0;
+  double doubles[] = { 0.0, -0.0, 1.5, -3e300, 1 / zero, -1 / zero, zero / zero };
+  for (int i = 0; i < 7; i++) {
+    object o = make_double(doubles[i]);
+    ASSERT(is(o, double));
+    if (doubles[i] == doubles[i]) {
+      ASSERT(doublev(&o) == doubles[i]);
+    } else {
+      ASSERT(doublev(&o) != doublev(&o));
+    }
+    doublev(&o) = doublev(&o) * zero;
+    ASSERT(is(o, double));
+  }
+
+  object b = make_byte(-1);
+  ASSERT(is(b, byte));
+  ASSERT_EQ(bytev(&b), -1);
+
+  string hello = "hello";
+  object s = make_string(hello);
+  ASSERT(is(s, string));
+  ASSERT(strcmp(stringv(&s), hello) == 0);
+  setstringv(&s, hello);
+  ASSERT(stringv(&s) == hello);
+  setstringv(&s, hello + 1);
+  ASSERT(is(s, string));
+  ASSERT(stringv(&s) == hello + 1);
+
+  object* l = list1(make_int(3));
+  ASSERT(is(*l, cell));
+  object c = make_cell(cellv(l));
+  ASSERT(is(c, cell));
+  ASSERT(cellv(&c) == cellv(l));
+
+  ASSERT(is(*NIL, nil));
+  ASSERT(is(*T, t));
+  ASSERT(!is(*NIL, t));
+  PASS();
+}
+
+TEST vector_test () {
+  object* v = ovector(0);
+  ASSERT(is(*v, vector));
+  ASSERT_EQ(olength(v).value.int_v, 0);
+  for (int i = 0; i < 100; i++) {
+    ovector_push(v, make_int(i));
+  }
+  ASSERT_EQ(olength(v).value.int_v, 100);
+  ASSERT(vectorv(v)->capacity >= 100);
+  ASSERT_EQ(intv(ovector_ref(v, 42)), 42);
+  ASSERT(is(*ovector_ref(v, 100), nil));
+  ASSERT(is(*ovector_ref(v, -1), nil));
+  ASSERT(ovector_set(v, 42, make_double(0.5)) == v);
+  ASSERT(is(*ovector_ref(v, 42), double));
+  ASSERT(is(*ovector_set(v, 100, make_int(0)), nil));
+
+  object* s = ovector_slice(v, 10, 20);
+  ASSERT_EQ(olength(s).value.int_v, 10);
+  ASSERT_EQ(intv(ovector_ref(s, 0)), 10);
+  ASSERT_EQ(olength(ovector_slice(v, 90, 200)).value.int_v, 10);
+  ASSERT_EQ(olength(ovector_slice(v, 20, 10)).value.int_v, 0);
+  object sum = oadd(s);
+  ASSERT(is(sum, int));
+  ASSERT_EQ(intv(&sum), 145);
+
+  object* l = list3(make_int(1), make_string("two"), make_double(3));
+  object* lv = ovector_from_list(l);
+  ASSERT_EQ(olength(lv).value.int_v, 3);
+  object two = make_string("two");
+  ASSERT(otruthy(*ostring_equal(ovector_ref(lv, 1), &two)));
+  ASSERT(otruthy(*oequal(ovector_to_list(lv), l)));
+  ASSERT(is(*ovector_to_list(ovector(0)), nil));
+
+  object* copy = ocopy(lv);
+  ASSERT(vectorv(copy) != vectorv(lv));
+  ASSERT(otruthy(*oequal(copy, lv)));
+  ovector_set(copy, 0, make_int(2));
+  ASSERT(ofalsy(*oequal(copy, lv)));
+  ASSERT(ofalsy(*oequal(copy, l)));
+
+  object* nested = list2(*lv, make_int(4));
+  ASSERT(otruthy(*oequal(&car(nested), lv)));
+  ASSERT_EQ(ofree(copy), 1);
+  PASS();
+}
+
+TEST hashmap_test () {
+  object* m = ohashmap(0);
+  ASSERT(is(*m, hashmap));
+  for (int i = 0; i < 1000; i++) {
+    ohashmap_set(m, make_int(i), make_int(i * 2));
+  }
+  ASSERT_EQ(ohashmap_count(m), 1000);
+  ASSERT_EQ(olength(m).value.int_v, 1000);
+  object three = make_double(3.0);
+  ASSERT_EQ(intv(ohashmap_get(m, &three)), 6);
+  object missing = make_int(1000);
+  ASSERT(ohashmap_get(m, &missing) == NULL);
+
+  for (int i = 0; i < 1000; i += 2) {
+    object key = make_int(i);
+    ASSERT(is(*ohashmap_delete(m, &key), t));
+    ASSERT(is(*ohashmap_delete(m, &key), nil));
+  }
+  ASSERT_EQ(ohashmap_count(m), 500);
+  ASSERT(ohashmap_get(m, &three) != NULL);
+  object four = make_int(4);
+  ASSERT(ohashmap_get(m, &four) == NULL);
+
+  long int sum = 0;
+  int seen = 0;
+  ohashmap_for_each(key, value, m) {
+    ASSERT_EQ(intv(value), intv(key) * 2);
+    sum += intv(key);
+    seen++;
+  }
+  ASSERT_EQ(seen, 500);
+  ASSERT_EQ(sum, 500 * 500);
+
+  long int strings = owned_strings.count;
+  object* names = ohashmap(4);
+  char buffer[32];
+  for (int i = 0; i < 20; i++) {
+    sprintf(buffer, "route number %d", i);
+    ohashmap_set(names, make_string(buffer), make_int(i));
+  }
+  strcpy(buffer, "overwritten");
+  object route = make_string("route number 7");
+  ASSERT_EQ(intv(ohashmap_get(names, &route)), 7);
+  object symbol = make_symbol("route number 7");
+  ohashmap_set(names, symbol, make_int(70));
+  ASSERT_EQ(ohashmap_count(names), 20);
+  ASSERT_EQ(intv(ohashmap_get(names, &route)), 70);
+  ohashmap_for_each(key, value, names) {
+    ASSERT(stringv(key) != buffer);
+  }
+
+  object* copy = ocopy(names);
+  ASSERT(copy != names);
+  ASSERT(otruthy(*oequal(copy, names)));
+  ASSERT_EQ(ohash(copy), ohash(names));
+  ohashmap_set(copy, make_string("extra"), *NIL);
+  ASSERT(ofalsy(*oequal(copy, names)));
+  ohashmap_delete(copy, &route);
+  ASSERT(ofalsy(*oequal(copy, names)));
+
+  ofree(copy);
+  ofree(names);
+  ASSERT_EQ(owned_strings.count, strings);
+  ofree(m);
+  PASS();
+}
+
+TEST unrolled_test () {
+  object* u = ounrolled();
+  ASSERT(is(*u, unrolled));
+  ASSERT(is(ounrolled_pop(u), nil));
+  ASSERT(ounrolled_ref(u, 0) == NIL);
+  for (int i = 0; i < 100; i++) {
+    ounrolled_push(u, make_int(i));
+    ounrolled_push_front(u, make_int(-i - 1));
+  }
+  ASSERT_EQ(olength(u).value.int_v, 200);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_EQ(intv(ounrolled_ref(u, i)), i - 100);
+  }
+  ASSERT(ounrolled_ref(u, 200) == NIL);
+  ASSERT(ounrolled_ref(u, -1) == NIL);
+  ASSERT_EQ(oadd(u).value.int_v, -100);
+
+  ASSERT(ounrolled_set(u, 150, make_double(0.5)) == u);
+  ASSERT_EQ(doublev(ounrolled_ref(u, 150)), 0.5);
+  ASSERT(ounrolled_set(u, 200, make_int(0)) == NIL);
+  ounrolled_set(u, 150, make_int(50));
+
+  int expected = -100;
+  ounrolled_for_each(elm, u) {
+    ASSERT_EQ(intv(elm), expected++);
+  }
+  ASSERT_EQ(expected, 100);
+
+  for (int i = 0; i < 90; i++) {
+    object front = ounrolled_pop_front(u);
+    object back = ounrolled_pop(u);
+    ASSERT_EQ(intv(&front), i - 100);
+    ASSERT_EQ(intv(&back), 99 - i);
+  }
+  ASSERT_EQ(unrolledv(u)->length, 20);
+  ASSERT_EQ(intv(ounrolled_ref(u, 0)), -10);
+  ASSERT_EQ(intv(ounrolled_ref(u, 19)), 9);
+
+  object* list = ounrolled_to_list(u);
+  ASSERT_EQ(olength(list).value.int_v, 20);
+  ASSERT_EQ(intv(&car(list)), -10);
+  object* back = ounrolled_from_list(list);
+  ASSERT(otruthy(*oequal(back, u)));
+  ASSERT_EQ(ohash(back), ohash(u));
+  ounrolled_push(back, make_int(10));
+  ASSERT(ofalsy(*oequal(back, u)));
+
+  object* copy = ocopy(u);
+  ASSERT(copy != u);
+  ASSERT(otruthy(*oequal(copy, u)));
+  while (!is(ounrolled_pop(copy), nil)) {
+  }
+  ASSERT_EQ(unrolledv(copy)->length, 0);
+  ASSERT(unrolledv(copy)->first == NULL);
+  ASSERT_EQ(olength(u).value.int_v, 20);
+
+  ofree(copy);
+  ofree(back);
+  ofree(list);
+  ofree(u);
+  PASS();
+}
+
+TEST deque_test () {
+  object* q = odeque(0);
+  ASSERT(is(*q, deque));
+  ASSERT(is(odeque_pop(q), nil));
+  ASSERT(is(odeque_pop_front(q), nil));
+
+  /* the ring wraps before it grows */
+  struct general_ring* ring = dequev(q)->ring;
+  for (int i = 0; i < 3; i++) {
+    odeque_push(q, make_int(i));
+  }
+  odeque_pop_front(q);
+  odeque_pop_front(q);
+  odeque_push(q, make_int(3));
+  odeque_push(q, make_int(4));
+  odeque_push_front(q, make_int(1));
+  ASSERT(dequev(q)->ring == ring);
+  ASSERT_EQ(olength(q).value.int_v, 4);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(intv(odeque_ref(q, i)), i + 1);
+  }
+  ASSERT(odeque_ref(q, 4) == NIL);
+  ASSERT(odeque_ref(q, -1) == NIL);
+
+  for (int i = 5; i < 100; i++) {
+    odeque_push(q, make_int(i));
+  }
+  odeque_push_front(q, make_int(0));
+  ASSERT_EQ(olength(q).value.int_v, 100);
+  int expected = 0;
+  odeque_for_each(elm, q) {
+    ASSERT_EQ(intv(elm), expected++);
+  }
+  ASSERT_EQ(expected, 100);
+  ASSERT_EQ(oadd(q).value.int_v, 4950);
+
+  ASSERT(odeque_set(q, 99, make_double(0.5)) == q);
+  ASSERT_EQ(doublev(odeque_ref(q, 99)), 0.5);
+  ASSERT(odeque_set(q, 100, make_int(0)) == NIL);
+  object last = odeque_pop(q);
+  ASSERT_EQ(doublev(&last), 0.5);
+  object first = odeque_pop_front(q);
+  ASSERT_EQ(intv(&first), 0);
+
+  object* list = odeque_to_list(q);
+  ASSERT_EQ(olength(list).value.int_v, 98);
+  ASSERT_EQ(intv(&car(list)), 1);
+  object* back = odeque_from_list(list);
+  ASSERT(otruthy(*oequal(back, q)));
+  ASSERT_EQ(ohash(back), ohash(q));
+  object* copy = ocopy(q);
+  ASSERT(otruthy(*oequal(copy, q)));
+  odeque_push_front(copy, make_int(0));
+  ASSERT(ofalsy(*oequal(copy, q)));
+
+  ofree(copy);
+  ofree(back);
+  ofree(list);
+  ofree(q);
+  PASS();
+}
+
+TEST vector_gc_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  object* v = ovector(2);
+  ogc_root(v);
+  for (int i = 0; i < 50; i++) {
+    ovector_push(v, *list2(make_int(i), make_string("vector item")));
+  }
+  list1(make_string("garbage item"));
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 1 + 50 * 2);
+  ASSERT_EQ(owned_strings.count, 1 + 50);
+
+  /* stores made while the vector is black */
+  gc_step_work = 1;
+  ogc_step();
+  while (!(opage(v)->flags[oslot_index(v)] & SLOT_MARK_OBJ)) {
+    ogc_step();
+  }
+  ovector_set(v, 0, *list1(make_string("late")));
+  for (int i = 0; i < 50; i++) {
+    ovector_push(v, *list1(make_int(i)));
+  }
+  gc_step_work = 1000;
+  while (gc_phase != GC_IDLE) {
+    ogc_step();
+  }
+  object late = make_string("late");
+  ASSERT(otruthy(*ostring_equal(&car(ovector_ref(v, 0)), &late)));
+  ASSERT_EQ(intv(&car(ovector_ref(v, 99))), 49);
+
+  object* kept = NULL;
+  oregion(r) {
+    object* local = ovector_from_list(list2(make_string("in"), make_int(2)));
+    ASSERT(opage(local)->region == r);
+    kept = opromote(local);
+  }
+  ASSERT(opage(kept)->region == NULL);
+  object in = make_string("in");
+  ASSERT(otruthy(*ostring_equal(ovector_ref(kept, 0), &in)));
+  ASSERT_EQ(ofree(kept), 1);
+
+  ogc_unroot(v);
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 0);
+  ASSERT_EQ(owned_strings.count, 0);
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST compact_gc_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  object* kept = ocompact(list3(make_int(1), make_string("a compact string"),
+                                *list1(make_string("a nested string"))));
+  ogc_root(kept);
+  ocompact(list2(make_int(1), make_int(2)));
+  ASSERT_EQ(compact_runs.count, 2);
+  ogc_collect();
+  ASSERT_EQ(compact_runs.count, 1);
+  ASSERT_EQ(owned_strings.count, 2);
+  ASSERT_EQ(olength(kept).value.int_v, 3);
+  object nested = make_string("a nested string");
+  ASSERT(otruthy(*oequal(&car(&car(cdr(cdr(kept)))), &nested)));
+
+  /* the moved cell is kept through its run */
+  osetcdr(kept, list1(make_string("moved")));
+  ogc_collect();
+  ASSERT_EQ(compact_runs.count, 1);
+  ASSERT_EQ(olength(kept).value.int_v, 2);
+  object moved = make_string("moved");
+  ASSERT(otruthy(*oequal(&car(cdr(kept)), &moved)));
+
+  ogc_unroot(kept);
+  ogc_collect();
+  ASSERT_EQ(compact_runs.count, 0);
+  ASSERT_EQ(objects_allocated, 0);
+  ASSERT_EQ(owned_strings.count, 0);
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST hashmap_gc_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  object* m = ohashmap(0);
+  ogc_root(m);
+  for (int i = 0; i < 50; i++) {
+    ohashmap_set(m, make_int(i), *list1(make_string("hashmap value")));
+  }
+  list1(make_string("garbage item"));
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 1 + 50);
+
+  /* entries added and moved while the hashmap is black */
+  gc_step_work = 1;
+  ogc_step();
+  while (!(opage(m)->flags[oslot_index(m)] & SLOT_MARK_OBJ)) {
+    ogc_step();
+  }
+  for (int i = 50; i < 200; i++) {
+    ohashmap_set(m, make_int(i), *list1(make_int(i)));
+  }
+  gc_step_work = 1000;
+  while (gc_phase != GC_IDLE) {
+    ogc_step();
+  }
+  ASSERT_EQ(ohashmap_count(m), 200);
+  for (int i = 0; i < 200; i++) {
+    object key = make_int(i);
+    object* value = ohashmap_get(m, &key);
+    ASSERT(value && is(*value, cell));
+    if (i >= 50) {
+      ASSERT_EQ(intv(&car(value)), i);
+    }
+  }
+
+  object* kept = NULL;
+  oregion(r) {
+    object* local = ohashmap(0);
+    ohashmap_set(local, make_string("region key"), make_int(1));
+    kept = opromote(local);
+  }
+  ASSERT(opage(kept)->region == NULL);
+  object key = make_string("region key");
+  ASSERT_EQ(intv(ohashmap_get(kept, &key)), 1);
+  ASSERT_EQ(ofree(kept), 1);
+
+  ogc_unroot(m);
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 0);
+  ASSERT_EQ(owned_strings.count, 0);
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST unrolled_gc_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  object* u = ounrolled();
+  ogc_root(u);
+  for (int i = 0; i < 50; i++) {
+    ounrolled_push(u, *list1(make_string("unrolled item")));
+  }
+  list1(make_string("garbage item"));
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 1 + 50);
+
+  /* items pushed while the list is black */
+  gc_step_work = 1;
+  ogc_step();
+  while (!(opage(u)->flags[oslot_index(u)] & SLOT_MARK_OBJ)) {
+    ogc_step();
+  }
+  for (int i = 0; i < 100; i++) {
+    ounrolled_push_front(u, *list1(make_int(i)));
+  }
+  gc_step_work = 1000;
+  while (gc_phase != GC_IDLE) {
+    ogc_step();
+  }
+  ASSERT_EQ(unrolledv(u)->length, 150);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(intv(&car(ounrolled_ref(u, i))), 99 - i);
+  }
+
+  object* kept = NULL;
+  oregion(r) {
+    object* local = ounrolled();
+    ounrolled_push(local, make_string("region item"));
+    kept = opromote(local);
+  }
+  ASSERT(opage(kept)->region == NULL);
+  object item = make_string("region item");
+  ASSERT(otruthy(*oequal(ounrolled_ref(kept, 0), &item)));
+  ASSERT_EQ(ofree(kept), 1);
+
+  ogc_unroot(u);
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 0);
+  ASSERT_EQ(owned_strings.count, 0);
+  gc_scan_stack = true;
+  PASS();
+}
+
+TEST headed_gc_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  object* h = oheaded(NIL);
+  ogc_root(h);
+  for (int i = 0; i < 50; i++) {
+    oheaded_add(h, make_string("headed item"));
+  }
+  list1(make_string("garbage item"));
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 1 + 50);
+  ASSERT_EQ(owned_strings.count, 1 + 50);
+
+  /* cells added at both ends while the header is black */
+  gc_step_work = 1;
+  ogc_step();
+  while (!(opage(h)->flags[oslot_index(h)] & SLOT_MARK_OBJ)) {
+    ogc_step();
+  }
+  for (int i = 0; i < 50; i++) {
+    opush(make_int(i), h);
+    oheaded_add(h, make_int(i));
+  }
+  gc_step_work = 1000;
+  while (gc_phase != GC_IDLE) {
+    ogc_step();
+  }
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 1 + 150);
+  ASSERT_EQ(olength(oheaded_list(h)).value.int_v, 150);
+
+  ogc_unroot(h);
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 0);
+  ASSERT_EQ(owned_strings.count, 0);
+  gc_scan_stack = true;
+  PASS();
+}
+
+object parallel_box(object* x) {
+  return *cons(*x, NIL);
+}
+
+bool parallel_box_odd(object* x) {
+  cons(*x, NIL);
+  return intv(x) % 2;
+}
+
+object parallel_box_sum(object a, object b) {
+  cons(b, NIL);
+  return make_int(intv(&a) + intv(&b));
+}
+
+pthread_t parallel_main;
+bool parallel_elsewhere = false;
+
+/**
+ * parallel_box() waiting at the start of each chunk, so the pool
+ * threads get chunks of their own even on one core.
+ */
+object parallel_box_slow(object* x) {
+  if (intv(x) % PARALLEL_CHUNK == 0) {
+    usleep(20000);
+  }
+  if (!pthread_equal(pthread_self(), parallel_main)) {
+    parallel_elsewhere = true;
+  }
+  return parallel_box(x);
+}
+
+TEST parallel_gc_test () {
+  int n = 5000;
+  int* xs = malloc(sizeof(int) * n);
+  for (int i = 0; i < n; i++) {
+    xs[i] = i;
+  }
+  object* list = list_from_ints(xs, n);
+  object* vec = ovector_from_list(list);
+  free(xs);
+  ogc_enable(200);
+  /* the second pass runs on the pool */
+  for (int pass = 0; pass < 2; pass++) {
+    if (pass) {
+      opool_start(3);
+      parallel_threshold = 1000;
+    }
+    for (int kind = 0; kind < 2; kind++) {
+      object* o = kind ? vec : list;
+      object* boxes = omap(o, parallel_box);
+      long int bad = 0;
+      object* box = boxes;
+      for (int i = 0; i < n; i++) {
+        object* x = kind ? ovector_ref(boxes, i) : &car(box);
+        bad += !is(*x, cell) || !is(car(x), int) || intv(&car(x)) != i;
+        box = kind ? box : cdr(box);
+      }
+      ASSERT_EQ(bad, 0);
+
+      object* odds = ofilter(o, parallel_box_odd);
+      ASSERT_EQ(kind ? vectorv(odds)->length : olength(odds).value.int_v, n / 2);
+      object* odd = kind ? ovector_ref(odds, n / 2 - 1) : olast(odds);
+      ASSERT_EQ(intv(kind ? odd : &car(odd)), n - 1);
+
+      object sum = oreduce(o, parallel_box_sum, make_int(0));
+      ASSERT_EQ(intv(&sum), n * (n - 1) / 2);
+    }
+  }
+
+  /* the pool threads gave up their heaps, so collecting goes on */
+  object* chunks = NIL;
+  for (int i = 0; i < 3 * PARALLEL_CHUNK; i++) {
+    chunks = cons(make_int(i), chunks);
+  }
+  parallel_main = pthread_self();
+  object* boxes = omap(chunks, parallel_box_slow);
+  ASSERT(parallel_elsewhere);
+  ASSERT_EQ(intv(&car(&car(boxes))), 3 * PARALLEL_CHUNK - 1);
+  long int cycles = gc_stats.cycles;
+  for (int i = 0; i < 1000; i++) {
+    cons(make_int(i), NIL);
+  }
+  ASSERT(gc_stats.cycles > cycles);
+  opool_stop();
+  cycles = gc_stats.cycles;
+  for (int i = 0; i < 1000; i++) {
+    cons(make_int(i), NIL);
+  }
+  ASSERT(gc_stats.cycles > cycles);
+  parallel_threshold = 4 * PARALLEL_CHUNK;
+  gc_threshold = 0;
+  PASS();
+}
+
+TEST deque_gc_test () {
+  gc_scan_stack = false;
+  ogc_collect();
+  object* q = odeque(2);
+  ogc_root(q);
+  for (int i = 0; i < 50; i++) {
+    odeque_push(q, *list1(make_string("deque item")));
+  }
+  list1(make_string("garbage item"));
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 1 + 50);
+
+  /* items pushed, and the ring regrown, while the deque is black */
+  gc_step_work = 1;
+  ogc_step();
+  while (!(opage(q)->flags[oslot_index(q)] & SLOT_MARK_OBJ)) {
+    ogc_step();
+  }
+  for (int i = 0; i < 100; i++) {
+    odeque_push_front(q, *list1(make_int(i)));
+  }
+  gc_step_work = 1000;
+  while (gc_phase != GC_IDLE) {
+    ogc_step();
+  }
+  ASSERT_EQ(olength(q).value.int_v, 150);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(intv(&car(odeque_ref(q, i))), 99 - i);
+  }
+
+  object* kept = NULL;
+  oregion(r) {
+    object* local = odeque(0);
+    odeque_push(local, make_string("region item"));
+    kept = opromote(local);
+  }
+  ASSERT(opage(kept)->region == NULL);
+  object item = make_string("region item");
+  ASSERT(otruthy(*oequal(odeque_ref(kept, 0), &item)));
+  ASSERT_EQ(ofree(kept), 1);
+
+  ogc_unroot(q);
+  ogc_collect();
+  ASSERT_EQ(objects_allocated, 0);
+  ASSERT_EQ(owned_strings.count, 0);
+  gc_scan_stack = true;
+  PASS();
+}
+
 SUITE(unit_math) {
   RUN_TEST(adding_integers_type);
   RUN_TEST(adding_integers_value);
@@ -473,30 +2557,78 @@ SUITE(unit_math) {
   RUN_TEST(number_equal_double);
   RUN_TEST(number_equal_mixed);
 
+  RUN_TEST(args_test);
+
+  RUN_TEST(array_test);
+  RUN_TEST(array_kernel_test);
+
 }
 
 SUITE(unit_list) {
   RUN_TEST(list_length);
   RUN_TEST(list_last);
   RUN_TEST(list_append);
+  RUN_TEST(list_builder_test);
+  RUN_TEST(list_bulk_test);
+  RUN_TEST(list_compact_test);
   RUN_TEST(list_push);
+  RUN_TEST(list_headed_test);
+  RUN_TEST(list_share_test);
+  RUN_TEST(list_share_deep_test);
+  RUN_TEST(list_atomic_test);
+  RUN_TEST(list_parallel_test);
   RUN_TEST(list_pop);
 }
 
 SUITE(unit_string) {
   RUN_TEST(string_equal);
+  RUN_TEST(string_test);
+  RUN_TEST(symbol_test);
 }
 
 SUITE(unit_object) {
+  RUN_TEST(representation_test);
   RUN_TEST(booly_test);
   RUN_TEST(for_each_test);
   RUN_TEST(object_copy);
+  RUN_TEST(object_copy_deep);
   RUN_TEST(object_equal);
+  RUN_TEST(object_parallel_test);
+  RUN_TEST(hash_test);
+  RUN_TEST(vector_test);
+  RUN_TEST(hashmap_test);
+  RUN_TEST(unrolled_test);
+  RUN_TEST(deque_test);
 }
 
 SUITE(memory) {
   RUN_TEST(oalloc_test);
   RUN_TEST(ofree_test);
+  RUN_TEST(slab_test);
+  RUN_TEST(region_test);
+  RUN_TEST(registry_test);
+  RUN_TEST(refs_test);
+  RUN_TEST(refs_thread_test);
+  RUN_TEST(heap_thread_test);
+  RUN_TEST(share_thread_test);
+  RUN_TEST(stack_thread_test);
+}
+
+SUITE(gc) {
+  RUN_TEST(gc_collect_test);
+  RUN_TEST(gc_threshold_test);
+  RUN_TEST(gc_incremental_test);
+  RUN_TEST(gc_barrier_test);
+  RUN_TEST(gc_thread_test);
+  RUN_TEST(gc_sweep_alloc_test);
+  RUN_TEST(gc_stats_test);
+  RUN_TEST(vector_gc_test);
+  RUN_TEST(compact_gc_test);
+  RUN_TEST(hashmap_gc_test);
+  RUN_TEST(unrolled_gc_test);
+  RUN_TEST(headed_gc_test);
+  RUN_TEST(deque_gc_test);
+  RUN_TEST(parallel_gc_test);
 }
 
 int main (int argc, char** argv) {
@@ -506,6 +2638,7 @@ int main (int argc, char** argv) {
   RUN_SUITE(unit_string);
   RUN_SUITE(unit_object);
   RUN_SUITE(memory);
+  RUN_SUITE(gc);
   GREATEST_MAIN_END();
 
 }